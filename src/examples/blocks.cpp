@@ -15,6 +15,7 @@
 #define TOYGL_ENABLE_LOGO
 #define TOYGL_ENABLE_TEXTURES
 #define TOYGL_ENABLE_RGB
+#define TOYGL_ENABLE_SIMD
 #include "../toygl.hpp"
 
 using tgl::vec3f;
@@ -61,6 +62,7 @@ int main(void) {
 
 	// create new TGL renderer
 	tgl::renderer rend( CANVAS_SIZE, CANVAS_SIZE, window_draw );
+	rend.set_target( canvas );
 	rend.set_distance( 15 );
 	rend.set_texture_src( texture_lamp, 16, 16 );
 
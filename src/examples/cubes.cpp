@@ -14,6 +14,7 @@
 #define TOYGL_ENABLE_LOGO
 #define TOYGL_ENABLE_TEXTURES
 #define TOYGL_ENABLE_RGB
+#define TOYGL_ENABLE_SIMD
 #include "../toygl.hpp"
 
 using tgl::vec3f;
@@ -86,6 +87,7 @@ int main(void) {
 
 	// create new TGL renderer
 	tgl::renderer rend( CANVAS_SIZE, CANVAS_SIZE, window_draw );
+	rend.set_target( canvas );
 	rend.set_distance( 15 );
 	rend.set_texture_src( texture, 8, 8 );
 
@@ -1,5 +1,6 @@
 
 #include <iostream>
+#include <vector>
 
 #define CANVAS_SIZE 400
 #define CANVAS_SCALE 2
@@ -15,6 +16,7 @@
 #define TOYGL_ENABLE_LOGO
 #define TOYGL_ENABLE_TEXTURES
 #define TOYGL_ENABLE_RGB
+#define TOYGL_ENABLE_SIMD
 #define TOYGL_ENABLE_DOUBLE
 #include "../toygl.hpp"
 
@@ -98,6 +100,15 @@ size_t map_id = 0;
 
 bool bw = false, bs = false, ba = false, bd = false;
 
+// wall and floor textures, with mipmaps for distant walls
+tgl::texture bricks( texture_bricks, 128, 128 );
+tgl::texture tiles( texture_tiles, 128, 128 );
+std::vector<byte> bricks_mips( bricks.mipmap_size( 3 ) );
+std::vector<byte> tiles_mips( tiles.mipmap_size( 3 ) );
+
+// the cube texture is tiny, so filter it to keep it smooth
+tgl::texture cube( texture_cube, 4, 4, tgl::wrap::clamp, tgl::filter::linear );
+
 void reset() {
 	pos = vec3f( 4, 0, 10 );
 	rot = vec3f( 0, 0, 0 );
@@ -156,7 +167,7 @@ void window_event_key( unsigned int keycode, bool pressed ) {
 void draw_intrest_point( tgl::renderer* ctx, vec3f v ) {
 
 	float s = 0.25;
-	ctx->set_texture_src( texture_cube, 4, 4 );
+	ctx->set_texture_src( cube );
 
 	ctx->set_texture_uv( trig2f( vec2f(0, 0), vec2f(0, 4), vec2f(4, 0) ) );
 	ctx->draw_3d_triangle( vec3f(v.x - s, v.y - s, v.z + s), vec3f(v.x - s, v.y + s, v.z + s), vec3f(v.x + s, v.y - s, v.z + s) );
@@ -191,7 +202,7 @@ void draw_map( tgl::renderer* ctx, tgl::byte map[8][8] ) {
 					draw_intrest_point( ctx, v );
 				}
 
-				ctx->set_texture_src( texture_bricks, 128, 128 );
+				ctx->set_texture_src( bricks );
 
 				if( map[y + 1][x] == 0 ) {
 					vec3f v( x * 2, 0, y * 2 + 2 );
@@ -225,7 +236,7 @@ void draw_map( tgl::renderer* ctx, tgl::byte map[8][8] ) {
 					ctx->draw_3d_triangle( vec3f(v.x + 1, v.y + 1, v.z + 1), vec3f(v.x + 1, v.y + 1, v.z - 1), vec3f(v.x + 1, v.y - 1, v.z + 1) );
 				}
 
-				ctx->set_texture_src( texture_tiles, 128, 128 );
+				ctx->set_texture_src( tiles );
 
 				vec3f v( x * 2, -2, y * 2);
 				ctx->set_texture_uv( trig2f( vec2f(0, 0), vec2f(0, 128), vec2f(128, 0) ) );
@@ -249,9 +260,13 @@ int main(void) {
 
 	// create new TGL renderer
 	tgl::renderer rend( CANVAS_SIZE, CANVAS_SIZE, window_draw );
+	rend.set_target( canvas );
 	rend.set_distance( 0 );
 	rend.set_clip( 0.0001, 100 );
 
+	bricks.mipmap( bricks_mips.data(), 3 );
+	tiles.mipmap( tiles_mips.data(), 3 );
+
 	std::string text = "FPS: 0";
 
 	while( !should_close ) {
@@ -0,0 +1,91 @@
+// stacks of camera facing quads, drawn in both orders, must show the nearest quad
+// with both depth formats, build and run it from the src directory with and without
+// TOYGL_ENABLE_DEPTH16:
+//
+//   mkdir -p build
+//   g++ -I. tests/depth.cpp -o build/depth && ./build/depth
+//   g++ -I. -DTOYGL_ENABLE_DEPTH16 tests/depth.cpp -o build/depth16 && ./build/depth16
+
+#include <cstdio>
+#include <algorithm>
+
+#define SIZE 200
+
+#define TOYGL_IMPLEMENT
+#define TOYGL_ENABLE_DEPTH
+#define TOYGL_ENABLE_3D
+#define TOYGL_ENABLE_RGB
+#include "../toygl.hpp"
+
+using tgl::vec3f;
+using tgl::byte;
+
+// distances from the camera, as fractions of the farthest distance that is not clipped
+const float distances[] = { 0.125, 0.14, 0.16, 0.2, 0.3, 0.5, 0.7, 0.95 };
+const uint layers = sizeof( distances ) / sizeof( float );
+
+void draw_layer( tgl::renderer& rend, uint layer, float range, byte* col ) {
+
+	// the quad grows with its distance, so that all layers cover the same pixels
+	const float d = distances[layer] * range;
+	const float h = d * 0.4f;
+	const float z = d - 10;
+
+	col[0] = (byte) (layer * 30 + 40);
+	col[1] = (byte) (255 - layer * 30);
+	col[2] = (byte) layer;
+
+	rend.set_color( col );
+	rend.draw_3d_triangle( vec3f(-h, -h, z), vec3f(h, -h, z), vec3f(-h, h, z) );
+	rend.draw_3d_triangle( vec3f(h, h, z), vec3f(-h, h, z), vec3f(h, -h, z) );
+
+}
+
+bool check( float near, float far, bool reverse ) {
+
+	static byte buffer[SIZE * SIZE * 3];
+	byte cols[layers][3];
+
+	tgl::renderer rend( SIZE, SIZE, nullptr );
+	rend.set_target( buffer );
+	rend.set_distance( 10 );
+	rend.set_clip( near, far );
+	rend.clear_depth();
+
+	// projected z is 255 at the far distance and must not exceed far
+	const float range = std::min( far, 255.0f ) * far / 255;
+
+	for( uint i = 0; i < layers; i ++ ) {
+		draw_layer( rend, reverse ? i : layers - 1 - i, range, cols[i] );
+	}
+
+	// the nearest layer is drawn first when reversed, last otherwise
+	const byte* nearest = cols[reverse ? 0 : layers - 1];
+	uint wrong = 0;
+
+	for( uint y = SIZE / 4; y < SIZE * 3 / 4; y ++ ) {
+		for( uint x = SIZE / 4; x < SIZE * 3 / 4; x ++ ) {
+			const byte* c = buffer + (y * SIZE + x) * 3;
+			if( c[0] != nearest[0] || c[1] != nearest[1] || c[2] != nearest[2] ) wrong ++;
+		}
+	}
+
+	printf( "clip %g-%g %s: %u wrong pixels\n", near, far, reverse ? "near first" : "far first", wrong );
+	return wrong == 0;
+
+}
+
+int main() {
+
+	bool ok = true;
+
+	ok &= check( 1, 1000, false );
+	ok &= check( 1, 1000, true );
+	ok &= check( 0.1, 100, false );
+	ok &= check( 0.1, 100, true );
+	ok &= check( 1, 255, false );
+	ok &= check( 1, 255, true );
+
+	return ok ? 0 : 1;
+
+}
@@ -54,12 +54,15 @@
  *
  * 		define TOYGL_ENABLE_3D to add 3D functions
  * 		define TOYGL_ENABLE_DEPTH to enable depth buffer
+ * 		define TOYGL_ENABLE_DEPTH16 to store depth as 16 bit fixed point (requires TOYGL_ENABLE_DEPTH)
  * 		define TOYGL_ENABLE_LOGO to add draw_logo method
  * 		define TOYGL_ENABLE_TEXTURES to add texture system
  * 		define TOYGL_ENABLE_RGB to add basic RGB constants and functions
  * 		define TOYGL_ENABLE_PUBLIC_MODE to make all tgl::renderer fields public
  * 		define TOYGL_ENABLE_CONTEXT to add 'tgl::renderer*' as a argument for pixel placer
  * 		define TOYGL_ENABLE_DOUBLE to use double precision
+ * 		define TOYGL_ENABLE_SIMD to process 4 (SSE2) or 8 (AVX2) pixels at a time
+ * 		define TOYGL_ENABLE_THREADS to add multithreaded tile rendering (requires C++11)
  *
  * 3. Renderer:
  *
@@ -88,6 +91,152 @@
  * 				some_screen_buffer[x][y][2] = c[2]; // blue
  * 			}, 3 );
  *
+ * 		Optionally a span_placer can be set using `set_span_placer`, it will then
+ * 		be invoked once for every horizontal run of pixels (solid fills, glyph rows,
+ * 		images and textured triangles) instead of calling pixel_placer for every pixel:
+ *
+ * 			unsigned int y, y position of the run
+ * 			unsigned int x0, x position of the first pixel of the run
+ * 			unsigned int x1, x position of the last pixel of the run (inclusive)
+ * 			tgl::color c, a pointer to the color of the first pixel
+ * 			unsigned int stride, offset to the color of the next pixel (0 if all pixels share color `c`)
+ *
+ * 		Example:
+ *
+ * 			rend.set_span_placer( [] ( uint y, uint x0, uint x1, tgl::color c, uint stride ) -> void {
+ * 				for( uint x = x0; x <= x1; x ++, c += stride ) {
+ * 					memcpy( some_screen_buffer[x][y], c, 3 );
+ * 				}
+ * 			} );
+ *
+ * 		Alternatively, TGL can write pixels directly into a color buffer, in
+ * 		which case no placer is invoked at all (pixel_placer can then be nullptr):
+ *
+ * 			rend.set_target( buffer, pitch = 0 );
+ *
+ * 		where buffer is a row-major array of channel-count-sized pixels, and pitch
+ * 		is the size of one row in bytes (0 for width * channels). If buffer is nullptr
+ * 		TGL will allocate (and later free) its own buffer, use `get_target` to access it.
+ *
+ * 		When the placer is known at compile time tgl::basic_renderer can be used
+ * 		instead, it accepts any functor type callable as `placer( x, y, c )`
+ * 		and a constant channel count, so that the placer can be inlined:
+ *
+ * 			struct screen_placer {
+ * 				void operator()( uint x, uint y, tgl::color c ) { ... }
+ * 			};
+ *
+ * 			tgl::basic_renderer<screen_placer, 3> rend( width, height );
+ *
+ * 		tgl::basic_renderer is a tgl::renderer, so it supports all the methods
+ * 		listed below (and TOYGL_ENABLE_CONTEXT does not change the functor signature).
+ * 		Only the placer calls and single pixels use the constant channel count, the
+ * 		shared drawing code (texturing included) still reads it at run time.
+ *
+ * 		With TOYGL_ENABLE_THREADS triangles can be rendered by a pool of threads:
+ *
+ * 			rend.set_threads( count );
+ *
+ * 			rend.begin_tiles();
+ * 			// draw_triangle and draw_3d_triangle calls
+ * 			rend.end_tiles();
+ *
+ * 		triangles drawn between `begin_tiles` and `end_tiles` are only recorded
+ * 		(together with the current color, depth and texture), `end_tiles` splits
+ * 		them into TOYGL_TILE_SIZE tiles and renders all tiles in parallel. Colors and
+ * 		textures must stay valid until then, and the placers must accept concurrent
+ * 		calls for different pixels. Other draw calls are not recorded.
+ *
+ * 		`draw_triangle` accepts both tgl::vec2i and tgl::vec2f vertices, integer
+ * 		triangles include all pixels on their edges, while float triangles (and all
+ * 		3D triangles) are snapped to TOYGL_SUBPIXEL_BITS (default 4) fractional bits and
+ * 		follow the top-left rule, so triangles sharing an edge never overlap nor leave gaps.
+ *
+ * 		Textures of 3D triangles are perspective correct, the exact texture coordinates are
+ * 		computed every TOYGL_PERSPECTIVE_STEP (default 8) pixels and interpolated linearly
+ * 		in between, higher values are faster but less accurate (1 computes every pixel).
+ *
+ * 		Textures can be described once with a tgl::texture and reused:
+ *
+ * 			tgl::texture bricks( buffer, 128, 128, tgl::wrap::repeat );
+ * 			rend.set_texture_src( bricks );
+ *
+ * 		texture coordinates outside of the texture are clamped to its edge (tgl::wrap::clamp,
+ * 		the default, also used by `set_texture_src( buffer, width, height )`) or repeat it
+ * 		(tgl::wrap::repeat). Textures with power of two dimensions are sampled faster.
+ *
+ * 		Textures created with tgl::filter::linear blend the 4 nearest texels of every pixel
+ * 		(in 8.8 fixed point) instead of taking the nearest one, which makes magnified
+ * 		textures smooth instead of blocky, with TOYGL_ENABLE_SIMD 3 and 4 channel
+ * 		texels are blended all at once:
+ *
+ * 			tgl::texture cube( buffer, 4, 4, tgl::wrap::clamp, tgl::filter::linear );
+ *
+ * 		Textures can also store 4 or 8 bit indices into a palette of colors, which takes
+ * 		2 to 6 times less memory than storing the colors. 4 bit indices are packed two
+ * 		per byte, the first texel in the lower 4 bits:
+ *
+ * 			tgl::texture bricks( indices, 128, 128, palette, 4 );
+ *
+ * 		`compress` stores a texture in 8 byte blocks of 4x4 texels (the BC1 format, 4 bits
+ * 		per texel, 6 times less than RGB), which are decoded when sampled. The buffer must
+ * 		hold width * height / 2 bytes, width and height must be multiples of 4, and the
+ * 		renderer must have 3 or 4 channels (the 4th is always 255):
+ *
+ * 			bricks.compress( compressed_buffer, 3 );
+ *
+ * 		Textures with power of two dimensions can have mipmaps, every textured triangle
+ * 		then samples the level which best matches its size on the screen. The buffer must
+ * 		hold `mipmap_size( channels )` bytes, and `mipmap` must be called before `set_texture_src`:
+ *
+ * 			bricks.mipmap( mip_buffer, 3 );
+ *
+ * 		Textures drawn at an angle read texels far apart in memory, `tile` copies the
+ * 		texels into 4x4 blocks (width and height must be multiples of 4) so that
+ * 		neighbouring texels share cache lines. The buffer must be as large as the texture:
+ *
+ * 			bricks.tile( tiled_buffer, 3 );
+ *
+ * 		The texture mapping of a triangle is only computed once it draws its first pixel,
+ * 		the last TOYGL_TEXTURE_CACHE (default 32) mappings are remembered and reused when
+ * 		a triangle with the same screen and texture coordinates is drawn again.
+ *
+ * 		`draw_3d_mesh` draws triangles that share vertices, every vertex is projected once
+ * 		and every 3 indices (unsigned short or uint) form a triangle:
+ *
+ * 			rend.draw_3d_mesh( vertices, vertex_count, indices, index_count );
+ *
+ * 		Large numbers of vertices can be projected at once with `project_vectors`, which
+ * 		takes separate arrays of x, y and z coordinates and, with TOYGL_ENABLE_SIMD,
+ * 		projects 4 or 8 vertices at a time. `draw_3d_mesh` uses it for its vertices.
+ *
+ * 		With TOYGL_ENABLE_DEPTH scenes with a lot of overdraw can be drawn in two passes:
+ *
+ * 			rend.set_depth_pass( tgl::pass::depth );
+ * 			// 3D draw calls, only the depth buffer is written
+ * 			rend.set_depth_pass( tgl::pass::color );
+ * 			// same 3D draw calls, only the visible pixels are drawn
+ * 			rend.set_depth_pass( tgl::pass::all );
+ *
+ * 		the second pass textures and places only the pixels whose depth is equal
+ * 		to the one stored by the first pass, the geometry must be exactly the same.
+ *
+ * 		Pixels that pass the depth test can be counted, for example to skip drawing an
+ * 		object when even its bounding box would not be visible:
+ *
+ * 			rend.set_depth_pass( tgl::pass::test ); // nothing is written
+ * 			rend.begin_query();
+ * 			// draw bounding box
+ * 			uint visible = rend.end_query();
+ * 			rend.set_depth_pass( tgl::pass::all );
+ *
+ * 		3D triangles and lines store a depth linear in 1 / z (which, unlike z, can be
+ * 		interpolated linearly across the screen), mapped from the near and far clip planes
+ * 		of `set_clip` to 0 and 255 so that TOYGL_ENABLE_DEPTH16 keeps 8 fractional bits
+ * 		over the whole range, the near plane must be greater than 0. The 16 bit steps
+ * 		are then even in 1 / z, so their size grows as the near plane gets closer to 0,
+ * 		keep it near the closest geometry when using TOYGL_ENABLE_DEPTH16.
+ *
  * 4. TGL renderer methods:
  *
  *		All 3D draw/cfg calls and `draw_logo` are DISABLED
@@ -99,6 +248,7 @@
  * 			draw_unsafe_pixel
  * 			draw_line
  * 			draw_triangle
+ * 			draw_span
  * 			draw_square
  * 			draw_circle
  * 			draw_glyph
@@ -108,11 +258,17 @@
  * 			draw_texture
  * 			draw_3d_line
  * 			draw_3d_triangle
+ * 			draw_3d_mesh
  * 			draw_3d_cube
  *
  * 		Configuration calls:
  * 			set_color
+ * 			set_span_placer
+ * 			set_target
  * 			set_depth
+ * 			set_depth_pass
+ * 			begin_query
+ * 			end_query
  * 			set_texture
  * 			set_texture_src
  * 			set_texture_uv
@@ -122,6 +278,9 @@
  * 			set_scale
  * 			set_fov
  * 			set_clip
+ * 			set_threads
+ * 			begin_tiles
+ * 			end_tiles
  *
  * 5. Math overview:
  *
@@ -138,6 +297,9 @@
  *			tgl::vec2i - vector of 2 ints
  *				with fields .x, .y
  *
+ *			tgl::edge2i - integer edge equation of a 2D line
+ *				with fields .a, .b, .c (a * x + b * y + c)
+ *
  *			tgl::mat3x3f - 3x3 float matrix
  *				with fields .mYX, where Y is 0-2 row number and
  *				X is 0-2 column number.
@@ -171,11 +333,49 @@
 // used only for std::min & std::max
 #include <algorithm>
 
+// used for malloc & memcpy
+#include <cstdlib>
+#include <cstring>
+
+#ifdef TOYGL_ENABLE_THREADS
+#	include <vector>
+#	include <thread>
+#	include <mutex>
+#	include <atomic>
+#	include <condition_variable>
+#endif
+
+// size (in pixels) of the square tiles used by the tile renderer
+#ifndef TOYGL_TILE_SIZE
+#	define TOYGL_TILE_SIZE 64
+#endif
+
+// tiles can't share the 8x8 depth tiles of the Hi-Z buffer
+#if TOYGL_TILE_SIZE % 8 != 0
+#	error "TOYGL_TILE_SIZE must be a multiple of 8"
+#endif
+
+// number of fractional bits of sub-pixel vertex positions
+#ifndef TOYGL_SUBPIXEL_BITS
+#	define TOYGL_SUBPIXEL_BITS 4
+#endif
+
+// number of texture mapping matrices remembered by every renderer
+#ifndef TOYGL_TEXTURE_CACHE
+#	define TOYGL_TEXTURE_CACHE 32
+#endif
+
+// distance (in pixels) between exact perspective texture coordinates,
+// pixels in between are interpolated linearly
+#ifndef TOYGL_PERSPECTIVE_STEP
+#	define TOYGL_PERSPECTIVE_STEP 8
+#endif
+
 // define depth test enable/disable macros
 #ifdef TOYGL_ENABLE_DEPTH
 #	define __TOYGL_DEPTH_BEGIN( ctx ) ctx->depth_flag = ctx->depth_enable
 #	define __TOYGL_DEPTH_END( ctx ) ctx->depth_flag = false
-#	define __TOYGL_DEPTH_SET( ctx, val ) ctx->depth = (val)
+#	define __TOYGL_DEPTH_SET( ctx, val ) ctx->depth = (val); ctx->depth_dx = 0; ctx->depth_dy = 0
 #	define TOYGL_DEPTH( ctx, val, ... ) __TOYGL_DEPTH_BEGIN(ctx); __TOYGL_DEPTH_SET(ctx, val); __VA_ARGS__ __TOYGL_DEPTH_END(ctx);
 #else
 #	define __TOYGL_DEPTH_BEGIN( ctx )
@@ -194,10 +394,31 @@ typedef double float_tgl;
 typedef float float_tgl;
 #endif
 
+// 16 bit depth has 8 fractional bits, enough for the 0-255 range
+#ifdef TOYGL_ENABLE_DEPTH16
+typedef unsigned short depth_tgl;
+#	define TOYGL_DEPTH_CLEAR 0xFFFF
+#else
+typedef float depth_tgl;
+#	define TOYGL_DEPTH_CLEAR FLT_MAX
+#endif
+
 #if defined(_WIN32) || defined(_WIN64)
 typedef unsigned int uint;
 #endif
 
+// select the widest instruction set the compiler targets,
+// scalar code is used when none of them is available
+#ifdef TOYGL_ENABLE_SIMD
+#	if defined(__AVX2__)
+#		include <immintrin.h>
+#		define TOYGL_SIMD_WIDTH 8
+#	elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		include <emmintrin.h>
+#		define TOYGL_SIMD_WIDTH 4
+#	endif
+#endif
+
 #define TOYGL_VERSION "ToyGL 1.0.1"
 
 namespace tgl {
@@ -210,8 +431,10 @@ namespace tgl {
 
 #ifdef TOYGL_ENABLE_CONTEXT
 	typedef void (*pixel_placer)( renderer*, uint, uint, color );
+	typedef void (*span_placer)( renderer*, uint, uint, uint, color, uint );
 #else
 	typedef void (*pixel_placer)( uint, uint, color );
+	typedef void (*span_placer)( uint, uint, uint, color, uint );
 #endif
 
 	struct vec3f {
@@ -263,6 +486,110 @@ namespace tgl {
 
 	};
 
+	struct edge2i {
+
+		// edge equation a * x + b * y + c, equal to
+		// tgl::math::cross( x, y, v1.x, v1.y, v2.x, v2.y )
+		long long a, b, c;
+
+		edge2i( vec2i v1, vec2i v2, int shift = 0 );
+		long long at( int x, int y );
+		void negate();
+		void top_left();
+		void flip();
+		bool span( int y, int& l, int& r );
+		int test( int x0, int y0, int x1, int y1 );
+
+	};
+
+#ifdef TOYGL_ENABLE_DEPTH
+	namespace pass {
+
+		// depth tested draws write both depth and color
+		const byte all = 0;
+
+		// depth tested draws write only depth
+		const byte depth = 1;
+
+		// depth tested draws write only color, and only where the depth is equal
+		const byte color = 2;
+
+		// depth tested draws write nothing, see renderer::begin_query
+		const byte test = 3;
+
+	}
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	namespace wrap {
+
+		// coordinates outside of the texture use the nearest edge texel
+		const byte clamp = 0;
+
+		// coordinates outside of the texture repeat it
+		const byte repeat = 1;
+
+	}
+
+	namespace filter {
+
+		// every pixel takes the color of the nearest texel
+		const byte nearest = 0;
+
+		// every pixel blends the 4 nearest texels
+		const byte linear = 1;
+
+	}
+
+	struct texture {
+
+		tgl::byte* data;
+		uint width, height;
+
+		// largest coordinates, also the coordinate masks of power of two textures
+		int xmax, ymax;
+
+		// row pitch of power of two textures, as a shift
+		uint shift;
+		bool pow2;
+		byte wrap;
+		byte filter;
+
+		// texels are stored in 4x4 blocks, see tile
+		bool tiled;
+
+		// smaller copies of the texture, each half the size of the previous one
+		tgl::byte* mips;
+		uint levels;
+
+		// with 4 or 8 bits the data holds indices into the palette,
+		// with 0 bits it holds the colors themselves
+		tgl::byte* palette;
+		byte bits;
+
+		// the data holds 8 byte blocks of 4x4 texels, see compress,
+		// the last decoded block is kept in the cache
+		bool compressed;
+		uint cache_block;
+		tgl::byte cache[16 * 4];
+
+		texture();
+		texture( tgl::byte* data, uint width, uint height, byte wrap = tgl::wrap::clamp, byte filter = tgl::filter::nearest );
+		texture( tgl::byte* data, uint width, uint height, tgl::byte* palette, byte bits, byte wrap = tgl::wrap::clamp, byte filter = tgl::filter::nearest );
+		bool tile( tgl::byte* buffer, uint channels );
+		bool compress( tgl::byte* buffer, uint channels );
+		bool mipmap( tgl::byte* buffer, uint channels );
+		uint mipmap_size( uint channels );
+		tgl::texture level( uint level, uint channels );
+		inline uint index( int u, int v );
+		inline uint offset( uint u, uint v );
+		inline void wrap_coords( int& u, int& v );
+		inline tgl::byte* texel( uint offset, uint channels );
+		void decode_block( uint block, uint channels );
+
+	};
+#endif
+
 #ifdef TOYGL_ENABLE_RGB
 	namespace rgb {
 
@@ -275,28 +602,48 @@ namespace tgl {
 	}
 #endif
 
+	template< typename Placer, byte Channels >
+	class basic_renderer;
+
 	class renderer {
 
+		template< typename Placer, byte Channels >
+		friend class basic_renderer;
+
 		public:
 			renderer( uint x, uint y, pixel_placer placer, byte channels = 3 );
-			~renderer();
+			virtual ~renderer();
 
 			void set_color( color col );
+			void set_span_placer( span_placer spans );
+			void set_target( tgl::byte* buffer, uint pitch = 0 );
+			tgl::byte* get_target();
 
 #ifdef TOYGL_ENABLE_DEPTH
 			void set_depth( bool enable );
+			void set_depth_pass( byte pass );
 			void clear_depth();
+			void begin_query();
+			uint end_query();
 #endif
 
 #ifdef TOYGL_ENABLE_TEXTURES
 		public:
 			void set_texture( bool enable );
 			void set_texture_src( tgl::byte* buffer, uint width, uint height );
+			void set_texture_src( const tgl::texture& texture );
 			void set_texture_uv( trig2f uv );
 
 			void draw_texture( uint x, uint y, uint scale = 1 );
 
 			mat3x3f triangle_mapping_matrix( trig2f t1, trig2f t2 );
+			mat3x3f triangle_mapping_matrix( trig2f t1, trig2f t2, vec3f w );
+#endif
+
+#ifdef TOYGL_ENABLE_THREADS
+			void set_threads( uint count );
+			void begin_tiles();
+			void end_tiles();
 #endif
 
 #ifdef TOYGL_ENABLE_3D
@@ -312,6 +659,9 @@ namespace tgl {
 			void draw_unsafe_pixel( uint x, uint y );
 			void draw_line( vec2i v1, vec2i v2 );
 			void draw_triangle( vec2i v1, vec2i v2, vec2i v3 );
+			void draw_triangle( vec2f v1, vec2f v2, vec2f v3 );
+			void draw_span( uint y, uint x0, uint x1 );
+			void draw_span( uint y, uint x0, uint x1, color c, uint stride );
 			void draw_square( vec2i v1, vec2i v2 );
 			void draw_circle( vec2i pos, int r );
 			void draw_glyph( uint x, uint y, const byte* glyph, unsigned int scale = 1 );
@@ -324,8 +674,11 @@ namespace tgl {
 
 #ifdef TOYGL_ENABLE_3D
 			void project_vector( vec3f& vec );
+			void project_vectors( float_tgl* xs, float_tgl* ys, float_tgl* zs, uint count );
 			void draw_3d_line( vec3f v1, vec3f v2 );
 			void draw_3d_triangle( vec3f v1, vec3f v2, vec3f v3 );
+			void draw_3d_mesh( const vec3f* vertices, uint count, const unsigned short* indices, uint index_count );
+			void draw_3d_mesh( const vec3f* vertices, uint count, const uint* indices, uint index_count );
 			void draw_3d_cube( vec3f pos );
 
 #ifdef TOYGL_ENABLE_PUBLIC_MODE
@@ -345,6 +698,14 @@ namespace tgl {
 
 			vec3f cam = vec3f( 0, 0, 0 );
 			float far, near, dist, fov, scale;
+
+			// projected vertices of the last mesh, all x, then all y, then all z
+			float_tgl* mesh_buffer;
+			uint mesh_size;
+
+			inline float projected_depth( float z );
+			void draw_projected_triangle( vec3f v1, vec3f v2, vec3f v3 );
+			template< typename Index > void draw_indexed_mesh( const vec3f* vertices, uint count, const Index* indices, uint index_count );
 #endif
 
 			const uint width, xo;
@@ -352,13 +713,47 @@ namespace tgl {
 			const int wen, hen;
 			const byte channels;
 			pixel_placer placer;
+			span_placer spans;
 			color col;
 
+			// row of colors passed to span_placer
+			tgl::byte* span_buffer;
+
+			// color buffer used in place of the placers
+			tgl::byte* target;
+			uint target_pitch;
+			bool target_owned;
+
+			virtual void place_span( uint y, uint x0, uint x1, color c, uint stride );
+			inline void place_pixel( uint x, uint y );
+			void draw_triangle_row( int y, int l, int r );
+			void raster_triangle( vec2i v1, vec2i v2, vec2i v3, bool subpixel );
+
 #ifdef TOYGL_ENABLE_DEPTH
-			float* depth_buffer;
+			depth_tgl* depth_buffer;
+
+			// coarse depth, the max depth of every 8x8 tile, dirty
+			// tiles were written to and need to be recomputed
+			depth_tgl* hiz_buffer;
+			byte* hiz_dirty;
+			uint hiz_width;
+
+			// tiles with a frame other than depth_frame were cleared
+			// since they were last written to, and hold stale depth
+			uint* hiz_frame;
+			uint depth_frame;
+
+			// number of pixels that passed the depth test
+			uint depth_passed;
+
+			inline void touch_depth( uint y, uint x0, uint x1 );
+			inline void mark_depth( uint y, uint x0, uint x1 );
+			inline void depth_run( uint y, uint x0, uint x1, color c, uint stride );
+			depth_tgl hiz_at( uint tx, uint ty );
 
 		public:
-			float depth;
+			float depth, depth_dx, depth_dy;
+			byte depth_pass;
 			bool depth_flag: 1;
 			bool depth_enable: 1;
 #endif
@@ -371,20 +766,178 @@ namespace tgl {
 
 #ifdef TOYGL_ENABLE_TEXTURES
 			bool texture_flag: 1;
+			bool texture_deferred: 1;
+			bool texture_perspective: 1;
 			mat3x3f texture_matrix;
-			uint texture_width, texture_height;
-			tgl::byte* texture;
+			vec3f texture_w = vec3f( 1, 1, 1 );
+
+			// everything the texture matrix is computed from, the matrix is
+			// only computed once the triangle draws its first pixel
+			struct texture_key {
+				int screen[6];
+				float_tgl uv[6];
+				float_tgl w[3];
+				int unit;
+			};
+
+			struct texture_entry {
+				texture_key key;
+				mat3x3f matrix;
+			};
+
+			texture_key texture_pending;
+			bool texture_dirty: 1;
+			texture_entry texture_cache[TOYGL_TEXTURE_CACHE];
+			tgl::texture texture;
+			tgl::texture texture_level;
 			trig2f texture_triangle = trig2f( vec2f(0, 0), vec2f(0, 0), vec2f(0, 0) );
+
+			inline void draw_texel( uint x, uint y, uint index, bool buffered );
+			inline void draw_filtered( int y, int l, int r, int o, float_tgl u, float_tgl v, float_tgl du, float_tgl dv, bool buffered );
+			void shade_span( int y, int l, int r );
+			void setup_texture();
+#endif
+
+			// area to which triangles are clipped, whole canvas or a single tile
+			int clip_x0, clip_y0, clip_x1, clip_y1;
+
+			// state set up the same way by every constructor
+			void init_state();
+
+			// renderer passed to the placers of TOYGL_ENABLE_CONTEXT
+			inline renderer* context();
+
+#ifdef TOYGL_ENABLE_THREADS
+			struct bin_triangle {
+
+				vec2i v1, v2, v3;
+				bool subpixel;
+				color col;
+
+#ifdef TOYGL_ENABLE_DEPTH
+				float depth, depth_dx, depth_dy;
+				byte depth_pass;
+				bool depth_flag;
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+				bool texture_flag;
+				bool texture_perspective;
+				vec3f texture_w;
+				tgl::texture texture;
+				trig2f texture_triangle;
+#endif
+
+				bin_triangle( renderer* ctx, vec2i v1, vec2i v2, vec2i v3, bool subpixel );
+				void apply( renderer* ctx );
+
+			};
+
+			// creates a tile worker sharing buffers with `owner`
+			renderer( renderer* owner );
+
+			void tile_loop( uint id );
+			void draw_tile( renderer* worker, uint tile );
+
+			renderer* owner;
+			std::vector<renderer*> workers;
+			std::vector<std::thread> threads;
+			std::vector<bin_triangle> bin;
+			std::vector< std::vector<uint> > tiles;
+			uint tiles_x, tiles_y;
+
+			std::mutex tile_mutex;
+			std::condition_variable tile_start, tile_end;
+			std::atomic<uint> tile_next;
+			uint tile_frame, tile_done;
+			bool tile_stop, binning;
+#endif
+
+	};
+
+	template< typename Placer, byte Channels = 3 >
+	class basic_renderer : public renderer {
+
+		public:
+			basic_renderer( uint x, uint y, Placer placer = Placer() ): renderer( x, y, nullptr, Channels ), out( placer ) {}
+
+			// hide the renderer versions, so that plain pixels
+			// reach the placer without going through place_span
+			inline void draw_pixel( uint x, uint y ) {
+#ifdef TOYGL_ENABLE_DEPTH
+				if( depth_flag ) {
+					renderer::draw_pixel( x, y );
+					return;
+				}
 #endif
 
+				// constant size copies compile to plain stores
+				if( target ) {
+					memcpy( target + y * target_pitch + x * Channels, col, Channels );
+					return;
+				}
+
+				out( x, y, col );
+			}
+
+			inline void draw_unsafe_pixel( uint x, uint y ) {
+				if( x < width && y < height ) draw_pixel( x, y );
+			}
+
+		private:
+			Placer out;
+
+			// called once per span, the loop is compiled with the placer inlined
+			void place_span( uint y, uint x0, uint x1, color c, uint stride ) {
+				if( x0 > x1 ) return;
+
+				if( target ) {
+					renderer::place_span( y, x0, x1, c, stride );
+					return;
+				}
+
+				for( uint x = x0; x <= x1; x ++, c += stride ) out( x, y, c );
+			}
+
 	};
 
+#ifdef TOYGL_SIMD_WIDTH
+	namespace simd {
+
+		uint depth_test( depth_tgl* row, float depth, float step, int x );
+		uint depth_equal( depth_tgl* row, float depth, float step, int x );
+
+#if defined(TOYGL_ENABLE_TEXTURES) && !defined(TOYGL_ENABLE_DOUBLE)
+		void texture_coords( mat3x3f& m, int x, int y, tgl::texture& texture, int* u, int* v );
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+		// texels are packed as 4 bytes, t holds the top and then the bottom row
+		inline uint bilinear( const uint* t, int fx, int fy );
+
+		// same as bilinear, but left and right texels follow each other in memory
+		inline uint bilinear_rows( const tgl::byte* top, const tgl::byte* bottom, uint channels, int fx, int fy );
+#endif
+
+#if defined(TOYGL_ENABLE_3D) && !defined(TOYGL_ENABLE_DOUBLE)
+		// p holds the parameters of renderer::project_vectors
+		void project( float* xs, float* ys, float* zs, const float* p );
+#endif
+
+	}
+#endif
+
 	namespace math {
 
 		bool invert_matrix( const mat3x3f& m, mat3x3f& im );
 		inline int max_clamp( int value, int max );
+		inline int clamp( int value, int min, int max );
 		inline float half_cross( float a, float b, vec2i& v2 );
 		inline float cross( float x1, float y1, float x2, float y2, float x3, float y3 );
+		inline long long floor_div( long long a, long long b );
+		inline long long ceil_div( long long a, long long b );
+		inline int isqrt( int value );
+		inline depth_tgl depth_value( float depth );
 		inline int max( int a, int b, int c );
 		inline int max( int a, int b, int c, int d );
 		inline int min( int a, int b, int c );
@@ -411,16 +964,52 @@ inline void tgl::renderer::draw_pixel( uint x, uint y ) {
 	if( depth_flag ) {
 
 		const int index = y * width + x;
+		const depth_tgl z = tgl::math::depth_value( (depth + depth_dy * y) + depth_dx * x );
+
+		touch_depth( y, x, x );
+
+		if( depth_pass == tgl::pass::color ) {
+			if( depth_buffer[index] != z ) return;
+		}else{
+			if( !(depth_buffer[index] > z) ) return;
+			depth_passed ++;
+
+			if( depth_pass == tgl::pass::test ) return;
+
+			depth_buffer[index] = z;
+			hiz_dirty[(y >> 3) * hiz_width + (x >> 3)] = 1;
 
-		if( depth_buffer[index] > depth ) {
-			depth_buffer[index] = depth;
-		}else return;
+			if( depth_pass == tgl::pass::depth ) return;
+		}
+
+#ifdef TOYGL_ENABLE_TEXTURES
+		if( texture_deferred ) {
+			shade_span( y, x, x );
+			return;
+		}
+#endif
 
 	}
 #endif
 
+	place_pixel( x, y );
+
+}
+
+inline void tgl::renderer::place_pixel( uint x, uint y ) {
+
+	if( target ) {
+		memcpy( target + y * target_pitch + x * channels, col, channels );
+		return;
+	}
+
+	if( !placer ) {
+		place_span( y, x, x, col, 0 );
+		return;
+	}
+
 #ifdef TOYGL_ENABLE_CONTEXT
-	placer( this, x, y, col );
+	placer( context(), x, y, col );
 #else
 	placer( x, y, col );
 #endif
@@ -435,115 +1024,392 @@ void tgl::renderer::set_color( color col ) {
 	this->col = col;
 }
 
-#ifdef TOYGL_ENABLE_DEPTH
-void tgl::renderer::set_depth( bool enable ) {
-	this->depth_enable = enable;
+void tgl::renderer::set_target( tgl::byte* buffer, uint pitch ) {
+	if( target_owned ) free( target );
+
+	target_pitch = pitch ? pitch : width * channels;
+	target_owned = !buffer;
+	target = buffer ? buffer : (tgl::byte*) malloc( target_pitch * height );
 }
 
-void tgl::renderer::clear_depth() {
-	for( unsigned int i = 0; i < width * height; i ++ ) {
-		depth_buffer[i] = FLT_MAX;
-	}
+tgl::byte* tgl::renderer::get_target() {
+	return target;
 }
-#endif
 
-#ifdef TOYGL_ENABLE_TEXTURES
+void tgl::renderer::set_span_placer( span_placer spans ) {
+	this->spans = spans;
 
-void tgl::renderer::set_texture( bool enable ) {
-	texture_flag = enable;
+	if( spans && !span_buffer ) {
+		span_buffer = (tgl::byte*) malloc( width * channels );
+	}
 }
 
-void tgl::renderer::set_texture_src( tgl::byte* buffer, uint w, uint h ) {
-	texture = buffer;
-	texture_width = w - 1;
-	texture_height = h - 1;
+#ifdef TOYGL_ENABLE_DEPTH
+void tgl::renderer::set_depth( bool enable ) {
+	this->depth_enable = enable;
 }
 
-void tgl::renderer::set_texture_uv( trig2f uv ) {
-	texture_triangle = uv;
+void tgl::renderer::set_depth_pass( byte pass ) {
+	this->depth_pass = pass;
 }
 
-void tgl::renderer::draw_texture( uint x, uint y, uint scale ) {
-	if( texture_flag ) {
-		draw_image( x, y, texture, texture_width + 1, texture_height + 1, scale );
+void tgl::renderer::begin_query() {
+	depth_passed = 0;
+
+#ifdef TOYGL_ENABLE_THREADS
+	for( uint i = 0; i < workers.size(); i ++ ) {
+		workers[i]->depth_passed = 0;
 	}
+#endif
 }
 
-#endif
+uint tgl::renderer::end_query() {
+	uint count = depth_passed;
 
-#ifdef TOYGL_ENABLE_3D
-void tgl::renderer::set_rotation( vec3f rot ) {
-	this->rxc = cos(rot.x);
-	this->rxs = sin(rot.x);
-	this->ryc = cos(rot.y);
-	this->rys = sin(rot.y);
-	this->rzc = cos(rot.z);
-	this->rzs = sin(rot.z);
-}
+#ifdef TOYGL_ENABLE_THREADS
+	for( uint i = 0; i < workers.size(); i ++ ) {
+		count += workers[i]->depth_passed;
+	}
+#endif
 
-void tgl::renderer::set_camera( vec3f pos ) {
-	this->cam = pos;
+	return count;
 }
 
-void tgl::renderer::set_distance( float dist ) {
-	this->dist = dist;
-}
+void tgl::renderer::clear_depth() {
 
-void tgl::renderer::set_scale( float scale ) {
-	this->scale = scale;
-}
+	// tiles are only cleared once they are used again
+	depth_frame ++;
 
-void tgl::renderer::set_fov( float fov ) {
-	this->fov = tan( fov / 2.0f );
-}
+	// frame counter wrapped around, old tiles could look up to date
+	if( depth_frame == 0 ) {
+		memset( hiz_frame, 0, hiz_width * ((height + 7) >> 3) * sizeof( uint ) );
+		depth_frame = 1;
+	}
 
-void tgl::renderer::set_clip( float near, float far ) {
-	this->near = near;
-	this->far = far;
 }
-#endif
 
-#ifdef TOYGL_ENABLE_LOGO
-void tgl::renderer::draw_logo( vec2i pos, uint size, color fg, color a, color b, color c, const byte font[][8] ) {
+inline void tgl::renderer::touch_depth( uint y, uint x0, uint x1 ) {
 
-	const int x = pos.x;
-	const int y = pos.y;
-	const int s = size * 8;
-	const int h = size * 4;
+	const uint ty = y >> 3;
 
-	if( x > wen || y > hen ) return;
+	for( uint tx = x0 >> 3; tx <= (x1 >> 3); tx ++ ) {
 
-	set_color( a );
-	draw_triangle( vec2i( x + h, y + s ), vec2i( x + s + h, y + s ), vec2i( x + s, y ) );
+		const uint index = ty * hiz_width + tx;
 
-	set_color( b );
-	draw_square( vec2i( x + s * 2, y ), vec2i( x + s * 3 - 1, y + s - 1 ) );
+		if( hiz_frame[index] != depth_frame ) {
 
-	set_color( c );
-	draw_circle( vec2i( x + s * 4, y + h ), h );
+			// clear the stale tile before it is used
+			const uint tx0 = tx << 3, tx1 = std::min( tx0 + 7, (uint) wen );
+			const uint ty0 = ty << 3, ty1 = std::min( ty0 + 7, (uint) hen );
 
-	set_color( fg );
-	draw_string( x + h + (h/3), y + s + h, "TGL", font, size, 0, h, 255, false );
+			for( uint i = ty0; i <= ty1; i ++ ) {
+				depth_tgl* row = depth_buffer + i * width;
 
-}
+#ifdef TOYGL_ENABLE_DEPTH16
+				// all bytes of the 16 bit clear value are the same
+				memset( row + tx0, 0xFF, (tx1 - tx0 + 1) * sizeof( depth_tgl ) );
+#else
+				for( uint j = tx0; j <= tx1; j ++ ) row[j] = TOYGL_DEPTH_CLEAR;
 #endif
+			}
 
-void tgl::renderer::draw_line( vec2i v1, vec2i v2 ) {
+			hiz_buffer[index] = TOYGL_DEPTH_CLEAR;
+			hiz_dirty[index] = 0;
+			hiz_frame[index] = depth_frame;
 
-	int lx = v2.x - v1.x;
-	int ly = v2.y - v1.y;
+		}
 
-	float inter = 0;
-	const int xf = tgl::math::signum(lx);
-	const int yf = tgl::math::signum(ly);
-	int cx, cy;
+	}
 
-	lx *= xf;
-	ly *= yf;
+}
 
-	if (lx > ly) {
-		const float step = (float) ly / lx;
-		while (inter < lx) {
+inline void tgl::renderer::mark_depth( uint y, uint x0, uint x1 ) {
+	memset( hiz_dirty + (y >> 3) * hiz_width + (x0 >> 3), 1, (x1 >> 3) - (x0 >> 3) + 1 );
+}
+
+inline void tgl::renderer::depth_run( uint y, uint x0, uint x1, color c, uint stride ) {
+
+	// run of pixels that passed the depth test
+	if( depth_pass == tgl::pass::all || depth_pass == tgl::pass::depth ) mark_depth( y, x0, x1 );
+	if( depth_pass != tgl::pass::color ) depth_passed += x1 - x0 + 1;
+	if( depth_pass == tgl::pass::depth || depth_pass == tgl::pass::test ) return;
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	if( texture_deferred ) {
+		shade_span( y, x0, x1 );
+		return;
+	}
+#endif
+
+	place_span( y, x0, x1, c, stride );
+
+}
+
+depth_tgl tgl::renderer::hiz_at( uint tx, uint ty ) {
+
+	const uint index = ty * hiz_width + tx;
+
+	if( hiz_frame[index] != depth_frame ) {
+		return TOYGL_DEPTH_CLEAR;
+	}
+
+	if( hiz_dirty[index] ) {
+
+		const uint x0 = tx << 3, x1 = std::min( x0 + 7, (uint) wen );
+		const uint y0 = ty << 3, y1 = std::min( y0 + 7, (uint) hen );
+		depth_tgl max = depth_buffer[y0 * width + x0];
+
+		for( uint y = y0; y <= y1; y ++ ) {
+			const depth_tgl* row = depth_buffer + y * width;
+
+			for( uint x = x0; x <= x1; x ++ ) {
+				max = std::max( max, row[x] );
+			}
+		}
+
+		hiz_buffer[index] = max;
+		hiz_dirty[index] = 0;
+
+	}
+
+	return hiz_buffer[index];
+
+}
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+
+void tgl::renderer::set_texture( bool enable ) {
+	texture_flag = enable;
+}
+
+void tgl::renderer::set_texture_src( tgl::byte* buffer, uint w, uint h ) {
+	texture = tgl::texture( buffer, w, h );
+}
+
+void tgl::renderer::set_texture_src( const tgl::texture& texture ) {
+	this->texture = texture;
+}
+
+void tgl::renderer::set_texture_uv( trig2f uv ) {
+	texture_triangle = uv;
+}
+
+inline void tgl::renderer::draw_texel( uint x, uint y, uint index, bool buffered ) {
+
+	col = texture_level.texel( index, channels );
+
+	if( buffered ) {
+		memcpy( span_buffer + x * channels, col, channels );
+	}else{
+		place_pixel( x, y );
+	}
+
+}
+
+inline void tgl::renderer::draw_filtered( int y, int l, int r, int o, float_tgl u, float_tgl v, float_tgl du, float_tgl dv, bool buffered ) {
+
+	// local copies, which the color stores below can not alias, so
+	// that they can stay in registers for the whole span
+	tgl::texture t = texture_level;
+	const uint n = channels;
+	tgl::byte* const row = span_buffer;
+	tgl::byte texel[256];
+
+	// texels of plain textures can be read without going through texel()
+	const bool direct = !t.bits && !t.compressed;
+
+	// 16.16 fixed point coordinates, relative to the texel centers, are stepped
+	// along the span, the top 8 bits of the fraction are the blend weights, u and v
+	// are those of pixel o, so that every pixel gets the same value however the
+	// row is split into spans
+	const long long su = (long long) std::floor( du * 65536 + (float_tgl) 0.5 );
+	const long long sv = (long long) std::floor( dv * 65536 + (float_tgl) 0.5 );
+	long long fu = (long long) std::floor( u * 65536 ) - 32768 + su * (l - o);
+	long long fv = (long long) std::floor( v * 65536 ) - 32768 + sv * (l - o);
+
+	for( int x = l; x <= r; x ++, fu += su, fv += sv ) {
+
+		int u0 = (int) (fu >> 16), u1 = u0 + 1;
+		int v0 = (int) (fv >> 16), v1 = v0 + 1;
+		const int fx = (int) (fu >> 8) & 255;
+		const int fy = (int) (fv >> 8) & 255;
+
+		t.wrap_coords( u0, v0 );
+		t.wrap_coords( u1, v1 );
+
+		const uint offsets[4] = { t.offset( u0, v0 ), t.offset( u1, v0 ), t.offset( u0, v1 ), t.offset( u1, v1 ) };
+		tgl::byte* out = buffered ? row + x * n : texel;
+
+#ifdef TOYGL_SIMD_WIDTH
+		// 3 and 4 channel texels fit in 32 bits, all of them are blended at once
+		if( n == 3 || n == 4 ) {
+
+			uint c;
+
+			// right texels usually follow the left ones, 8 byte reads of 3 channel
+			// texels also cover the next texel, which must still be in the row
+			if( direct && !t.tiled && u1 == u0 + 1 && (n == 4 || u1 < t.xmax) ) {
+				c = tgl::simd::bilinear_rows( t.data + offsets[0] * n, t.data + offsets[2] * n, n, fx, fy );
+			}else{
+
+				uint packed[4];
+
+				for( uint i = 0; i < 4; i ++ ) {
+					const tgl::byte* p = direct ? t.data + offsets[i] * n : t.texel( offsets[i], n );
+
+					if( n == 4 ) {
+						memcpy( packed + i, p, 4 );
+					}else{
+						packed[i] = p[0] | (p[1] << 8) | (p[2] << 16);
+					}
+				}
+
+				c = tgl::simd::bilinear( packed, fx, fy );
+
+			}
+
+			memcpy( out, &c, n );
+
+			if( !buffered ) {
+				col = out;
+				place_pixel( x, y );
+			}
+
+			continue;
+
+		}
+#endif
+
+		tgl::byte* p[4];
+		tgl::byte decoded[4][4];
+
+		for( uint i = 0; i < 4; i ++ ) {
+			p[i] = t.texel( offsets[i], n );
+
+			// compressed texels point into the block cache, which the next texel can replace
+			if( t.compressed ) {
+				memcpy( decoded[i], p[i], n );
+				p[i] = decoded[i];
+			}
+		}
+
+		// blend the columns, then the two results, 8 bit weights keep
+		// all intermediate values within 16 bits
+		for( uint c = 0; c < n; c ++ ) {
+			const int left = (p[0][c] * (256 - fy) + p[2][c] * fy) >> 8;
+			const int right = (p[1][c] * (256 - fy) + p[3][c] * fy) >> 8;
+			out[c] = (left * (256 - fx) + right * fx) >> 8;
+		}
+
+		if( !buffered ) {
+			col = out;
+			place_pixel( x, y );
+		}
+
+	}
+
+}
+
+void tgl::renderer::draw_texture( uint x, uint y, uint scale ) {
+	if( texture_flag ) {
+
+		if( !texture.tiled && !texture.bits ) {
+			draw_image( x, y, texture.data, texture.width, texture.height, scale );
+			return;
+		}
+
+		// tiled and indexed textures have no rows of colors to pass to draw_image
+		for( uint v = 0; v < texture.height; v ++ ) {
+			for( uint u = 0; u < texture.width; u ++ ) {
+
+				const int sx = x + u * scale;
+				const int sy = y + v * scale;
+
+				col = texture.texel( texture.offset( u, v ), channels );
+				draw_square( vec2i(sx, sy), vec2i(sx + scale - 1, sy + scale - 1) );
+
+			}
+		}
+
+	}
+}
+
+#endif
+
+#ifdef TOYGL_ENABLE_3D
+void tgl::renderer::set_rotation( vec3f rot ) {
+	this->rxc = cos(rot.x);
+	this->rxs = sin(rot.x);
+	this->ryc = cos(rot.y);
+	this->rys = sin(rot.y);
+	this->rzc = cos(rot.z);
+	this->rzs = sin(rot.z);
+}
+
+void tgl::renderer::set_camera( vec3f pos ) {
+	this->cam = pos;
+}
+
+void tgl::renderer::set_distance( float dist ) {
+	this->dist = dist;
+}
+
+void tgl::renderer::set_scale( float scale ) {
+	this->scale = scale;
+}
+
+void tgl::renderer::set_fov( float fov ) {
+	this->fov = tan( fov / 2.0f );
+}
+
+void tgl::renderer::set_clip( float near, float far ) {
+	this->near = near;
+	this->far = far;
+}
+#endif
+
+#ifdef TOYGL_ENABLE_LOGO
+void tgl::renderer::draw_logo( vec2i pos, uint size, color fg, color a, color b, color c, const byte font[][8] ) {
+
+	const int x = pos.x;
+	const int y = pos.y;
+	const int s = size * 8;
+	const int h = size * 4;
+
+	if( x > wen || y > hen ) return;
+
+	set_color( a );
+	draw_triangle( vec2i( x + h, y + s ), vec2i( x + s + h, y + s ), vec2i( x + s, y ) );
+
+	set_color( b );
+	draw_square( vec2i( x + s * 2, y ), vec2i( x + s * 3 - 1, y + s - 1 ) );
+
+	set_color( c );
+	draw_circle( vec2i( x + s * 4, y + h ), h );
+
+	set_color( fg );
+	draw_string( x + h + (h/3), y + s + h, "TGL", font, size, 0, h, 255, false );
+
+}
+#endif
+
+void tgl::renderer::draw_line( vec2i v1, vec2i v2 ) {
+
+	int lx = v2.x - v1.x;
+	int ly = v2.y - v1.y;
+
+	float inter = 0;
+	const int xf = tgl::math::signum(lx);
+	const int yf = tgl::math::signum(ly);
+	int cx, cy;
+
+	lx *= xf;
+	ly *= yf;
+
+	if (lx > ly) {
+		const float step = (float) ly / lx;
+		while (inter < lx) {
 			draw_unsafe_pixel( inter * xf + v1.x, inter * step * yf + v1.y );
 			inter ++;
 		}
@@ -557,6 +1423,157 @@ void tgl::renderer::draw_line( vec2i v1, vec2i v2 ) {
 
 }
 
+void tgl::renderer::draw_span( uint y, uint x0, uint x1 ) {
+	draw_span( y, x0, x1, col, 0 );
+}
+
+void tgl::renderer::draw_span( uint y, uint x0, uint x1, color c, uint stride ) {
+
+	if( x0 > x1 ) return;
+
+	if( placer && !spans && !target ) {
+
+		// fallback to placing pixels one by one
+		for( uint x = x0; x <= x1; x ++ ) {
+			col = c;
+			draw_pixel( x, y );
+			c += stride;
+		}
+
+		return;
+	}
+
+#ifdef TOYGL_ENABLE_DEPTH
+	if( depth_flag ) {
+
+		depth_tgl* row = depth_buffer + y * width;
+		uint start = x0;
+		bool run = false;
+
+		touch_depth( y, x0, x1 );
+
+		// depth is a plane, every pixel evaluates it in the same way no matter where
+		// the span starts, so that the color pass gets exactly the same values
+		const float z = depth + depth_dy * y;
+
+		// color pass only tests for equal depth, and neither it nor the test pass writes
+		const bool equal = depth_pass == tgl::pass::color;
+		const bool write = depth_pass == tgl::pass::all || depth_pass == tgl::pass::depth;
+
+		// split span into runs of pixels that pass the depth test
+		for( uint x = x0; x <= x1; ) {
+
+			uint mask, count;
+
+#ifdef TOYGL_SIMD_WIDTH
+			depth_tgl tail[TOYGL_SIMD_WIDTH] = {0};
+			depth_tgl* cells = row + x;
+
+			// pixels at the end of the span (or ones that must not
+			// be written to) are tested on a copy
+			count = std::min( x1 - x + 1, (uint) TOYGL_SIMD_WIDTH );
+			const bool copy = count < TOYGL_SIMD_WIDTH || !write;
+
+			if( copy ) cells = (depth_tgl*) memcpy( tail, cells, count * sizeof( depth_tgl ) );
+
+			mask = equal ? tgl::simd::depth_equal( cells, z, depth_dx, x ) : tgl::simd::depth_test( cells, z, depth_dx, x );
+
+			if( copy ) {
+				if( write ) memcpy( row + x, tail, count * sizeof( depth_tgl ) );
+				mask &= (1u << count) - 1;
+			}
+#else
+			const depth_tgl q = tgl::math::depth_value( z + depth_dx * x );
+
+			if( equal ) {
+				mask = row[x] == q;
+			}else{
+				mask = row[x] > q;
+				if( mask && write ) row[x] = q;
+			}
+
+			count = 1;
+#endif
+
+			// nothing changes in this group
+			if( mask == (run ? (1u << count) - 1 : 0) ) {
+				x += count;
+				continue;
+			}
+
+			for( uint i = 0; i < count; i ++, x ++ ) {
+				const bool pass = mask & (1 << i);
+
+				if( pass != run ) {
+					if( run ) depth_run( y, start, x - 1, c + (start - x0) * stride, stride );
+					start = x;
+					run = pass;
+				}
+			}
+
+		}
+
+		if( run ) depth_run( y, start, x1, c + (start - x0) * stride, stride );
+		return;
+	}
+#endif
+
+	place_span( y, x0, x1, c, stride );
+
+}
+
+void tgl::renderer::place_span( uint y, uint x0, uint x1, color c, uint stride ) {
+
+	if( x0 > x1 ) return;
+
+	if( target ) {
+
+		tgl::byte* out = target + y * target_pitch + x0 * channels;
+		const uint size = (x1 - x0 + 1) * channels;
+
+		if( stride == channels ) {
+			memcpy( out, c, size );
+			return;
+		}
+
+		if( stride == 0 ) {
+
+			// fill the run by doubling the already written part
+			memcpy( out, c, channels );
+
+			for( uint done = channels; done < size; done <<= 1 ) {
+				memcpy( out + done, out, std::min( done, size - done ) );
+			}
+
+			return;
+		}
+
+		for( uint x = x0; x <= x1; x ++ ) {
+			memcpy( out, c, channels );
+			out += channels;
+			c += stride;
+		}
+
+		return;
+	}
+
+#ifdef TOYGL_ENABLE_THREADS
+	if( !spans ) {
+
+		// tile worker of a renderer with its own place_span
+		owner->place_span( y, x0, x1, c, stride );
+		return;
+
+	}
+#endif
+
+#ifdef TOYGL_ENABLE_CONTEXT
+	spans( context(), y, x0, x1, c, stride );
+#else
+	spans( y, x0, x1, c, stride );
+#endif
+
+}
 
 void tgl::renderer::draw_square( vec2i v1, vec2i v2 ) {
 
@@ -570,12 +1587,8 @@ void tgl::renderer::draw_square( vec2i v1, vec2i v2 ) {
 	const int ymax = std::max( v1.y, v2.y );
 	const int ymin = std::min( v1.y, v2.y );
 
-	for( int x = xmin; x <= xmax; x ++ ) {
-		for( int y = ymin; y <= ymax; y ++ ) {
-
-			draw_pixel( x, y );
-
-		}
+	for( int y = ymin; y <= ymax; y ++ ) {
+		draw_span( y, xmin, xmax );
 	}
 
 }
@@ -588,391 +1601,1769 @@ void tgl::renderer::draw_circle( vec2i pos, int r ) {
 	const int ymin = tgl::math::max_clamp( pos.y - r, hen );
 	const int powr = r * r;
 
-	for( int x = xmax; x >= xmin; x -- ) {
-		bool painted = false;
+	for( int y = ymin; y <= ymax; y ++ ) {
+
+		const int py = powr - (y - pos.y) * (y - pos.y);
+		if( py < 0 ) continue;
+
+		// half of the width of the circle in this row
+		const int px = tgl::math::isqrt( py );
+
+		const int x0 = std::max( pos.x - px, xmin );
+		const int x1 = std::min( pos.x + px, xmax );
+
+		if( x0 <= x1 ) draw_span( y, x0, x1 );
+
+	}
+
+}
+
+void tgl::renderer::draw_glyph( uint x, uint y, const byte* glyph, unsigned int scale ) {
+
+	if( x > (uint) wen || y > (uint) hen ) return;
+
+	for( int gy = 0; gy < 8; gy ++ ) {
+		const byte bits = glyph[gy];
+
+		// draw every horizontal run of set bits at once
+		for( int gx = 0; gx < 8; gx ++ ) {
+			if( bits & (1 << gx) ) {
+
+				const int gs = gx;
+				while( gx < 7 && (bits & (1 << (gx + 1))) ) gx ++;
+
+				if( scale == 1 ) {
+					if( y + gy < height && x + gs <= (uint) wen ) draw_span( y + gy, x + gs, std::min( x + gx, (uint) wen ) );
+				}else{
+					const int sy = y + gy * scale;
+					draw_square( vec2i(x + gs * scale, sy), vec2i(x + (gx + 1) * scale - 1, sy + scale - 1) );
+				}
+
+			}
+		}
+	}
+
+}
+
+void tgl::renderer::draw_string( uint x, uint y, const char* text, const byte font[][8], unsigned int scale, int vs, int hs, int fmax, bool special ) {
+
+	if( x > (uint) wen || y > (uint) hen ) return;
+
+	const uint x0 = x;
+
+	for( int i = 0; true; i ++ ) {
+
+		const char chr = text[i];
+		if( chr != '\0' ) {
+
+			if( (byte) chr > fmax ) continue;
+
+			draw_glyph( x, y, (byte*) font[ (int) chr ], scale );
+
+			if( special ) {
+
+				if( chr == '\n' ) {
+					y += 8 + vs;
+					continue;
+				}
+
+				if( chr == '\r' ) {
+					x = x0;
+					continue;
+				}
+
+			}
+
+			x += 8 * scale + hs;
+
+		}else break;
+
+	}
+
+}
+
+void tgl::renderer::draw_triangle( vec2i v1, vec2i v2, vec2i v3 ) {
+	raster_triangle( v1, v2, v3, false );
+}
+
+void tgl::renderer::draw_triangle( vec2f v1, vec2f v2, vec2f v3 ) {
+
+	const float_tgl unit = 1 << TOYGL_SUBPIXEL_BITS;
+	const float_tgl limit = 1 << 24;
+
+	// convert to fixed point, far away vertices are clamped so that
+	// the edge equations can not overflow
+	vec2i p1( std::round( std::max( -limit, std::min( v1.x, limit ) ) * unit ), std::round( std::max( -limit, std::min( v1.y, limit ) ) * unit ) );
+	vec2i p2( std::round( std::max( -limit, std::min( v2.x, limit ) ) * unit ), std::round( std::max( -limit, std::min( v2.y, limit ) ) * unit ) );
+	vec2i p3( std::round( std::max( -limit, std::min( v3.x, limit ) ) * unit ), std::round( std::max( -limit, std::min( v3.y, limit ) ) * unit ) );
+
+	raster_triangle( p1, p2, p3, true );
+
+}
+
+void tgl::renderer::raster_triangle( vec2i v1, vec2i v2, vec2i v3, bool subpixel ) {
+
+#ifdef TOYGL_ENABLE_THREADS
+	if( binning ) {
+		bin.push_back( bin_triangle( this, v1, v2, v3, subpixel ) );
+		return;
+	}
+#endif
+
+	// vertices are either whole pixels or TOYGL_SUBPIXEL_BITS fixed point
+	const int shift = subpixel ? TOYGL_SUBPIXEL_BITS : 0;
+	const int unit = 1 << shift;
+
+	// bounding box of the pixels whose centers are inside of the triangle bounds
+	const int xmax = tgl::math::clamp( tgl::math::floor_div( tgl::math::max( v1.x, v2.x, v3.x ), unit ), clip_x0, clip_x1 );
+	const int xmin = tgl::math::clamp( tgl::math::ceil_div( tgl::math::min( v1.x, v2.x, v3.x ), unit ), clip_x0, clip_x1 );
+	const int ymax = tgl::math::clamp( tgl::math::floor_div( tgl::math::max( v1.y, v2.y, v3.y ), unit ), clip_y0, clip_y1 );
+	const int ymin = tgl::math::clamp( tgl::math::ceil_div( tgl::math::min( v1.y, v2.y, v3.y ), unit ), clip_y0, clip_y1 );
+
+	// slivers between pixel centers don't cover any pixel
+	if( xmin > xmax || ymin > ymax ) return;
+
+	// edge equations are evaluated at whole pixels, so scale them to the vertex precision
+	edge2i e1( v1, v2, shift );
+	edge2i e2( v2, v3, shift );
+	edge2i e3( v3, v1, shift );
+
+	// the sum of all edge equations is the same for every pixel (twice the
+	// signed area of the triangle), so its sign tells the orientation
+	const long long area = e1.c + e2.c + e3.c;
+
+	if( subpixel ) {
+
+		// sub-pixel triangles use the top-left fill rule, so that
+		// pixels on an edge shared by two triangles are drawn only once
+		if( area == 0 ) return;
+
+		if( area < 0 ) {
+			e1.negate();
+			e2.negate();
+			e3.negate();
+		}
+
+		e1.top_left();
+		e2.top_left();
+		e3.top_left();
+
+	}else{
+
+		// pixel (x,y) is inside when all edge equations are negative, or when all of
+		// them are non-negative, negative edges are flipped so that in both
+		// cases pixel is inside if all edges are non-negative
+		if( area < 0 ) {
+			e1.flip();
+			e2.flip();
+			e3.flip();
+		}
+
+	}
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	if( texture_flag ) {
+
+		// texture setup is deferred to setup_texture
+		texture_key& key = texture_pending;
+		memset( &key, 0, sizeof( texture_key ) );
+
+		key.screen[0] = v1.x; key.screen[1] = v1.y;
+		key.screen[2] = v2.x; key.screen[3] = v2.y;
+		key.screen[4] = v3.x; key.screen[5] = v3.y;
+
+		key.uv[0] = texture_triangle.v1.x; key.uv[1] = texture_triangle.v1.y;
+		key.uv[2] = texture_triangle.v2.x; key.uv[3] = texture_triangle.v2.y;
+		key.uv[4] = texture_triangle.v3.x; key.uv[5] = texture_triangle.v3.y;
+
+		if( texture_perspective ) {
+			key.w[0] = texture_w.x;
+			key.w[1] = texture_w.y;
+			key.w[2] = texture_w.z;
+		}
+
+		key.unit = unit;
+		texture_dirty = true;
+
+	}
+#endif
+
+#ifdef TOYGL_ENABLE_DEPTH
+	// nearest depth of the whole triangle
+	float near_depth = 0;
+
+	if( depth_flag ) {
+		const float_tgl f = unit;
+		near_depth = std::min( std::min( depth + depth_dx * (v1.x / f) + depth_dy * (v1.y / f), depth + depth_dx * (v2.x / f) + depth_dy * (v2.y / f) ), depth + depth_dx * (v3.x / f) + depth_dy * (v3.y / f) );
+	}
+#endif
+
+	// walk the bounding box in blocks of 8 rows (aligned to the canvas)
+	for( int y0 = ymin; y0 <= ymax; y0 = (y0 | 7) + 1 ) {
+
+		const int y1 = std::min( y0 | 7, ymax );
+
+		int bx0 = xmin;
+		int bx1 = xmax;
+
+#ifdef TOYGL_ENABLE_DEPTH
+		if( depth_flag && depth_pass != tgl::pass::color ) {
+
+			// nearest depth of the triangle in the given 8x8 tile of this block, if
+			// it is not closer than the furthest pixel of the tile nothing can pass
+			// the depth test there, so occluded tiles are cut from both ends of the block
+			const float ry = depth_dy > 0 ? y0 : y1;
+			const float dx0 = depth_dx > 0 ? 0 : 7;
+
+			while( bx0 <= bx1 && hiz_at( bx0 >> 3, y0 >> 3 ) <= tgl::math::depth_value( std::max( near_depth, depth + depth_dx * ((bx0 & ~7) + dx0) + depth_dy * ry ) ) ) bx0 = (bx0 | 7) + 1;
+			while( bx1 >= bx0 && hiz_at( bx1 >> 3, y0 >> 3 ) <= tgl::math::depth_value( std::max( near_depth, depth + depth_dx * ((bx1 & ~7) + dx0) + depth_dy * ry ) ) ) bx1 = (bx1 & ~7) - 1;
+
+			if( bx0 > bx1 ) continue;
+
+		}
+#endif
+
+		// classify edges against the whole block, an edge that is outside
+		// for all of its pixels rejects the block, and an edge that
+		// is inside for all of them can be skipped in its rows
+		const int t1 = e1.test( bx0, y0, bx1, y1 );
+		const int t2 = e2.test( bx0, y0, bx1, y1 );
+		const int t3 = e3.test( bx0, y0, bx1, y1 );
+
+		if( t1 < 0 || t2 < 0 || t3 < 0 ) continue;
+
+		for( int y = y0; y <= y1; y ++ ) {
+
+			int l = bx0;
+			int r = bx1;
+
+			// find the horizontal span covered by the triangle in this row
+			if( t1 == 0 && !e1.span( y, l, r ) ) continue;
+			if( t2 == 0 && !e2.span( y, l, r ) ) continue;
+			if( t3 == 0 && !e3.span( y, l, r ) ) continue;
+
+			draw_triangle_row( y, l, r );
+
+		}
+
+	}
+
+}
+
+void tgl::renderer::draw_triangle_row( int y, int l, int r ) {
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	if( texture_flag ) {
+
+#ifdef TOYGL_ENABLE_DEPTH
+		if( depth_flag ) {
+
+			// test depth first and texture only the pixels that passed,
+			// the depth and test passes do not need the texture at all
+			texture_deferred = depth_pass == tgl::pass::all || depth_pass == tgl::pass::color;
+			draw_span( y, l, r );
+			texture_deferred = false;
+
+			return;
+		}
+#endif
+
+		shade_span( y, l, r );
+		return;
+
+	}
+#endif
+
+	draw_span( y, l, r );
+
+}
+
+#ifdef TOYGL_ENABLE_TEXTURES
+void tgl::renderer::setup_texture() {
+
+	const texture_key& key = texture_pending;
+	texture_dirty = false;
+
+	// look for the same triangle in the cache
+	uint hash = 0;
+
+	for( uint i = 0; i < 6; i ++ ) {
+		hash = hash * 31 + key.screen[i];
+	}
+
+	texture_entry& entry = texture_cache[hash % TOYGL_TEXTURE_CACHE];
+
+	if( memcmp( &entry.key, &key, sizeof( texture_key ) ) != 0 ) {
+
+		const float_tgl unit = key.unit;
+
+		const trig2f screen( vec2f( key.screen[0] / unit, key.screen[1] / unit ), vec2f( key.screen[2] / unit, key.screen[3] / unit ), vec2f( key.screen[4] / unit, key.screen[5] / unit ) );
+		const trig2f uv( vec2f( key.uv[0], key.uv[1] ), vec2f( key.uv[2], key.uv[3] ), vec2f( key.uv[4], key.uv[5] ) );
+
+		entry.key = key;
+		entry.matrix = texture_perspective ? triangle_mapping_matrix( screen, uv, vec3f( key.w[0], key.w[1], key.w[2] ) ) : triangle_mapping_matrix( screen, uv );
+
+	}
+
+	texture_matrix = entry.matrix;
+	texture_level = texture;
+
+	if( texture.levels ) {
+
+		// texture coordinate derivatives at the center of the triangle,
+		// the matrix maps to (u/w, v/w, 1/w) so the quotient rule is needed
+		const float_tgl unit = key.unit;
+		const float_tgl cx = (key.screen[0] + key.screen[2] + key.screen[4]) / (3 * unit);
+		const float_tgl cy = (key.screen[1] + key.screen[3] + key.screen[5]) / (3 * unit);
+		const vec3f h = texture_matrix * vec3f( cx, cy, 1 );
+
+		if( !(h.z > 0) ) return;
+
+		const float_tgl dudx = texture_matrix.m00 * h.z - h.x * texture_matrix.m20;
+		const float_tgl dudy = texture_matrix.m01 * h.z - h.x * texture_matrix.m21;
+		const float_tgl dvdx = texture_matrix.m10 * h.z - h.y * texture_matrix.m20;
+		const float_tgl dvdy = texture_matrix.m11 * h.z - h.y * texture_matrix.m21;
+
+		// squared texels per pixel along the faster changing screen axis
+		const float_tgl rho = std::max( dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy ) / (h.z * h.z * h.z * h.z);
+
+		if( !(rho >= 4) ) return;
+
+		const uint level = std::min( (uint) (std::log2( rho ) / 2), texture.levels );
+		const float_tgl scale = (float_tgl) 1 / (1 << level);
+
+		// map to the texels of the selected level
+		texture_matrix.m00 *= scale; texture_matrix.m01 *= scale; texture_matrix.m02 *= scale;
+		texture_matrix.m10 *= scale; texture_matrix.m11 *= scale; texture_matrix.m12 *= scale;
+		texture_level = texture.level( level, channels );
+
+	}
+
+}
+
+void tgl::renderer::shade_span( int y, int l, int r ) {
+
+	if( texture_dirty ) setup_texture();
+
+	// texels are written directly to the target when there is one,
+	// otherwise they are collected and passed as one span
+	const bool buffered = !target && (spans || !placer);
+	const bool filtered = texture_level.filter == tgl::filter::linear;
+	int x = l;
+
+	if( texture_perspective ) {
+
+		// u/w, v/w and 1/w are linear along the row, the exact coordinates are only
+		// computed at multiples of TOYGL_PERSPECTIVE_STEP (so that spans split between
+		// tiles get the same texels) and interpolated in between, ends outside of
+		// the triangle, where 1/w can get to zero or below, are moved to the span
+		const float_tgl ru = y * texture_matrix.m01 + texture_matrix.m02;
+		const float_tgl rv = y * texture_matrix.m11 + texture_matrix.m12;
+		const float_tgl rw = y * texture_matrix.m21 + texture_matrix.m22;
+
+		int xa = x - x % TOYGL_PERSPECTIVE_STEP;
+		if( !(xa * texture_matrix.m20 + rw > 0) ) xa = x;
+
+		float_tgl w = 1 / (xa * texture_matrix.m20 + rw);
+		float_tgl ua = (xa * texture_matrix.m00 + ru) * w;
+		float_tgl va = (xa * texture_matrix.m10 + rv) * w;
+
+		while( x <= r ) {
+
+			int xb = xa + TOYGL_PERSPECTIVE_STEP;
+			if( !(xb * texture_matrix.m20 + rw > 0) ) xb = r;
+
+			w = 1 / (xb * texture_matrix.m20 + rw);
+			const float_tgl ub = (xb * texture_matrix.m00 + ru) * w;
+			const float_tgl vb = (xb * texture_matrix.m10 + rv) * w;
+
+			const float_tgl step = xb > xa ? (float_tgl) 1 / (xb - xa) : 0;
+			const float_tgl du = (ub - ua) * step;
+			const float_tgl dv = (vb - va) * step;
+
+			const int end = std::min( xa + TOYGL_PERSPECTIVE_STEP - 1, r );
+
+			// pixels are interpolated from xa, not from the start of the span
+			if( filtered ) {
+				draw_filtered( y, x, end, xa, ua, va, du, dv, buffered );
+				x = end + 1;
+			}else{
+				for( ; x <= end; x ++ ) {
+					const float_tgl u = ua + du * (x - xa);
+					const float_tgl v = va + dv * (x - xa);
+
+					draw_texel( x, y, texture_level.index( std::floor( u ), std::floor( v ) ), buffered );
+				}
+			}
+
+			xa = xb;
+			ua = ub;
+			va = vb;
+
+		}
+
+		if( buffered ) place_span( y, l, r, span_buffer + l * channels, channels );
+		return;
+
+	}
+
+#if defined(TOYGL_SIMD_WIDTH) && !defined(TOYGL_ENABLE_DOUBLE)
+	// only clamping and masking can be vectorized
+	if( !filtered && (texture_level.wrap == tgl::wrap::clamp || texture_level.pow2) ) {
+		for( ; r - x >= TOYGL_SIMD_WIDTH - 1; x += TOYGL_SIMD_WIDTH ) {
+
+			int uvx[TOYGL_SIMD_WIDTH], uvy[TOYGL_SIMD_WIDTH];
+			tgl::simd::texture_coords( texture_matrix, x, y, texture_level, uvx, uvy );
+
+			for( int i = 0; i < TOYGL_SIMD_WIDTH; i ++ ) {
+				draw_texel( x + i, y, texture_level.offset( uvx[i], uvy[i] ), buffered );
+			}
+
+		}
+	}
+#endif
+
+	// affine mapping, the last row of the matrix is always (0, 0, 1)
+	const float_tgl ru = y * texture_matrix.m01;
+	const float_tgl rv = y * texture_matrix.m11;
+
+	// filtered coordinates are stepped from the start of the row
+	if( filtered ) {
+		draw_filtered( y, x, r, 0, ru + texture_matrix.m02, rv + texture_matrix.m12, texture_matrix.m00, texture_matrix.m10, buffered );
+		x = r + 1;
+	}
+
+	for( ; x <= r; x ++ ) {
+
+		// map pixel (x,y) to texture coordinates and quarry color
+		const float_tgl u = x * texture_matrix.m00 + ru + texture_matrix.m02;
+		const float_tgl v = x * texture_matrix.m10 + rv + texture_matrix.m12;
+
+		draw_texel( x, y, texture_level.index( std::floor( u ), std::floor( v ) ), buffered );
+
+	}
+
+	if( buffered ) place_span( y, l, r, span_buffer + l * channels, channels );
+
+}
+#endif
+
+void tgl::renderer::draw_image( uint x, uint y, tgl::byte* buffer, uint w, uint h, uint scale ) {
+
+	if( x > (uint) wen || y > (uint) hen ) return;
+
+	const int xmax = tgl::math::max_clamp( x + w, wen );
+	const int ymax = tgl::math::max_clamp( y + h, hen );
+
+	for( int yc = y; yc < ymax; yc ++ ) {
+		col = buffer + yc * w * channels;
+
+		if( scale == 1 ) {
+			if( (int) x < xmax ) draw_span( yc, x, xmax - 1, col, channels );
+			continue;
+		}
+
+		for( int xc = x; xc < xmax; xc ++ ) {
+
+			const int sx = xc * scale;
+			const int sy = yc * scale;
+			draw_square( vec2i(sx, sy), vec2i(sx + scale - 1, sy + scale - 1) );
+
+			col += channels;
+
+		}
+	}
+
+}
+
+#ifdef TOYGL_ENABLE_TEXTURES
+
+tgl::mat3x3f tgl::renderer::triangle_mapping_matrix( trig2f t1, trig2f t2 ) {
+	return triangle_mapping_matrix( t1, t2, vec3f( 1, 1, 1 ) );
+}
+
+tgl::mat3x3f tgl::renderer::triangle_mapping_matrix( trig2f t1, trig2f t2, vec3f w ) {
+
+	mat3x3f invm = {0};
+
+	{
+		const mat3x3f m1 = {
+			t1.v1.x, t1.v2.x, t1.v3.x,
+			t1.v1.y, t1.v2.y, t1.v3.y,
+			1, 1, 1
+		};
+
+		if( !tgl::math::invert_matrix( m1, invm ) ) return mat3x3f {0};
+	}
+
+	// w is the inverse depth of the vertices, the matrix then maps to (u/w, v/w, 1/w)
+	mat3x3f m2 = {
+		t2.v1.x * w.x, t2.v2.x * w.y, t2.v3.x * w.z,
+		t2.v1.y * w.x, t2.v2.y * w.y, t2.v3.y * w.z,
+		w.x, w.y, w.z
+	};
+
+	return m2 * invm;
+
+}
+
+#endif
+
+#ifdef TOYGL_ENABLE_3D
+
+void tgl::renderer::project_vector( vec3f& vec ) {
+
+	vec.x -= cam.x;
+	vec.y -= cam.y;
+	vec.z -= cam.z;
+
+	vec.x *= scale;
+	vec.y *= scale;
+	vec.z *= scale;
+
+	const float a = rzs * vec.y + rzc * vec.x;
+	const float b = rzc * vec.y - rzs * vec.x;
+	const float c = ryc * vec.z + rys * a;
+
+	vec.x = ryc * a - rys * vec.z;
+	vec.y = rxs * c + rxc * b;
+	vec.z = rxc * c - rxs * b;
+
+	const float d = vec.z + dist, m = width / (d * fov);
+	vec.x *= m;
+	vec.y *= m;
+
+	vec.z = d * (255.0f / far);
+	vec.x += xo;
+	vec.y += yo;
+
+}
+
+void tgl::renderer::project_vectors( float_tgl* xs, float_tgl* ys, float_tgl* zs, uint count ) {
+
+	uint i = 0;
+
+#if defined(TOYGL_SIMD_WIDTH) && !defined(TOYGL_ENABLE_DOUBLE)
+	const float p[16] = {
+		cam.x, cam.y, cam.z, scale,
+		rzc, rzs, ryc, rys, rxc, rxs,
+		dist, fov, (float) width, 255.0f / far,
+		(float) xo, (float) yo
+	};
+
+	for( ; i + TOYGL_SIMD_WIDTH <= count; i += TOYGL_SIMD_WIDTH ) {
+		tgl::simd::project( xs + i, ys + i, zs + i, p );
+	}
+#endif
+
+	for( ; i < count; i ++ ) {
+		vec3f v( xs[i], ys[i], zs[i] );
+		project_vector( v );
+
+		xs[i] = v.x;
+		ys[i] = v.y;
+		zs[i] = v.z;
+	}
+
+}
+
+inline float tgl::renderer::projected_depth( float z ) {
+	// 1 / z is linear in screen space, near maps to 0 and far to 255
+	return 255 * (1 - near / z) / (1 - near / far);
+}
+
+void tgl::renderer::draw_3d_line( vec3f v1, vec3f v2 ) {
+
+	project_vector( v1 );
+	project_vector( v2 );
+
+	TOYGL_DEPTH( this, (projected_depth( v1.z ) + projected_depth( v2.z )) * 0.5f, {
+
+		vec2i p1( std::round(v1.x), std::round(v1.y) );
+		vec2i p2( std::round(v2.x), std::round(v2.y) );
+
+		draw_line( p1, p2 );
+
+	} );
+
+}
+
+void tgl::renderer::draw_3d_triangle( vec3f v1, vec3f v2, vec3f v3 ) {
+
+	project_vector( v1 );
+	project_vector( v2 );
+	project_vector( v3 );
+
+	draw_projected_triangle( v1, v2, v3 );
+
+}
+
+void tgl::renderer::draw_projected_triangle( vec3f v1, vec3f v2, vec3f v3 ) {
+
+	if (v1.z <= near || v2.z <= near || v3.z <= near || v1.z > far || v2.z > far || v3.z > far) return;
+
+	const vec3f a( v2.x - v1.x, v2.y - v1.y, v2.z - v1.z );
+	const vec3f b( v3.x - v1.x, v3.y - v1.y, v3.z - v1.z );
+	const float area = a.x * b.y - a.y * b.x;
+
+	// check normal
+	if( area <= 0 ) return;
+
+	__TOYGL_DEPTH_BEGIN( this );
+
+#ifdef TOYGL_ENABLE_DEPTH
+	// interpolate depth across the triangle, as a plane
+	// depth + depth_dx * x + depth_dy * y in screen space
+	const float d1 = projected_depth( v1.z );
+	const float da = projected_depth( v2.z ) - d1;
+	const float db = projected_depth( v3.z ) - d1;
+
+	depth_dx = (da * b.y - db * a.y) / area;
+	depth_dy = (a.x * db - b.x * da) / area;
+	depth = d1 - depth_dx * v1.x - depth_dy * v1.y;
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	// projected z is proportional to view depth
+	texture_w = vec3f( 1 / v1.z, 1 / v2.z, 1 / v3.z );
+	texture_perspective = true;
+#endif
+
+	draw_triangle( vec2f( v1.x, v1.y ), vec2f( v2.x, v2.y ), vec2f( v3.x, v3.y ) );
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	texture_perspective = false;
+#endif
+
+	__TOYGL_DEPTH_END( this );
+
+}
+
+void tgl::renderer::draw_3d_mesh( const vec3f* vertices, uint count, const unsigned short* indices, uint index_count ) {
+	draw_indexed_mesh( vertices, count, indices, index_count );
+}
+
+void tgl::renderer::draw_3d_mesh( const vec3f* vertices, uint count, const uint* indices, uint index_count ) {
+	draw_indexed_mesh( vertices, count, indices, index_count );
+}
+
+template< typename Index >
+void tgl::renderer::draw_indexed_mesh( const vec3f* vertices, uint count, const Index* indices, uint index_count ) {
+
+	if( count > mesh_size ) {
+		mesh_buffer = (float_tgl*) realloc( mesh_buffer, count * 3 * sizeof( float_tgl ) );
+		mesh_size = count;
+	}
+
+	float_tgl* xs = mesh_buffer;
+	float_tgl* ys = mesh_buffer + count;
+	float_tgl* zs = mesh_buffer + count * 2;
+
+	for( uint i = 0; i < count; i ++ ) {
+		xs[i] = vertices[i].x;
+		ys[i] = vertices[i].y;
+		zs[i] = vertices[i].z;
+	}
+
+	// every vertex is projected only once, no matter how many triangles share it
+	project_vectors( xs, ys, zs, count );
+
+	for( uint i = 0; i + 2 < index_count; i += 3 ) {
+		const Index i1 = indices[i], i2 = indices[i + 1], i3 = indices[i + 2];
+		draw_projected_triangle( vec3f( xs[i1], ys[i1], zs[i1] ), vec3f( xs[i2], ys[i2], zs[i2] ), vec3f( xs[i3], ys[i3], zs[i3] ) );
+	}
+
+}
+
+// Deprecated
+void tgl::renderer::draw_3d_cube( vec3f v ) {
+
+	const vec3f corners[8] = {
+		vec3f(v.x - 1, v.y - 1, v.z - 1), vec3f(v.x + 1, v.y - 1, v.z - 1), vec3f(v.x - 1, v.y + 1, v.z - 1), vec3f(v.x + 1, v.y + 1, v.z - 1),
+		vec3f(v.x - 1, v.y - 1, v.z + 1), vec3f(v.x + 1, v.y - 1, v.z + 1), vec3f(v.x - 1, v.y + 1, v.z + 1), vec3f(v.x + 1, v.y + 1, v.z + 1)
+	};
+
+	// bits 0, 1 and 2 of a corner index select +x, +y and +z
+	const unsigned short indices[36] = {
+		4, 6, 5,  7, 5, 6,
+		0, 1, 2,  3, 2, 1,
+		1, 5, 3,  7, 3, 5,
+		0, 2, 4,  6, 4, 2,
+		2, 3, 6,  7, 6, 3,
+		0, 4, 1,  5, 1, 4
+	};
+
+	draw_3d_mesh( corners, 8, indices, 36 );
+
+}
+
+#endif
+
+tgl::renderer::renderer( uint x, uint y, pixel_placer placer, byte _channels ):
+		width( x ),
+		xo( x >> 1 ),
+		height( y ),
+		yo( y >> 1 ),
+		wen( x - 1 ),
+		hen( y - 1 ),
+		channels( _channels ) {
+
+	this->placer = placer;
+	this->spans = nullptr;
+	this->span_buffer = placer ? nullptr : (tgl::byte*) malloc( x * _channels );
+	this->target = nullptr;
+	this->target_pitch = 0;
+	this->col = _channels == 3 ? tgl::rgb::black : nullptr;
+
+	init_state();
+
+#ifdef TOYGL_ENABLE_THREADS
+	this->owner = nullptr;
+	this->tiles_x = (x + TOYGL_TILE_SIZE - 1) / TOYGL_TILE_SIZE;
+	this->tiles_y = (y + TOYGL_TILE_SIZE - 1) / TOYGL_TILE_SIZE;
+	this->tiles.resize( tiles_x * tiles_y );
+#endif
+
+#ifdef TOYGL_ENABLE_DEPTH
+	this->depth_buffer = (depth_tgl*) malloc( x * y * sizeof( depth_tgl ) );
+	this->hiz_width = (x + 7) >> 3;
+	this->hiz_buffer = (depth_tgl*) malloc( hiz_width * ((y + 7) >> 3) * sizeof( depth_tgl ) );
+	this->hiz_dirty = (tgl::byte*) malloc( hiz_width * ((y + 7) >> 3) );
+	memset( this->hiz_dirty, 1, hiz_width * ((y + 7) >> 3) );
+	this->hiz_frame = (uint*) calloc( hiz_width * ((y + 7) >> 3), sizeof( uint ) );
+	this->depth_frame = 0;
+#endif
+
+#ifdef TOYGL_ENABLE_3D
+	set_rotation( vec3f(0, 0, 0) );
+	set_camera( vec3f(0, 0, 0) );
+	set_distance( 10 );
+	set_fov( 80 );
+	set_clip( 1, 255 );
+	set_scale( 1 );
+#endif
+
+}
+
+void tgl::renderer::init_state() {
+
+	this->target_owned = false;
+
+	this->clip_x0 = 0;
+	this->clip_y0 = 0;
+	this->clip_x1 = wen;
+	this->clip_y1 = hen;
+
+#ifdef TOYGL_ENABLE_THREADS
+	this->tile_frame = 0;
+	this->tile_done = 0;
+	this->tile_stop = false;
+	this->binning = false;
+#endif
+
+#ifdef TOYGL_ENABLE_DEPTH
+	this->depth = 0;
+	this->depth_dx = 0;
+	this->depth_dy = 0;
+	this->depth_pass = tgl::pass::all;
+	this->depth_passed = 0;
+	this->depth_flag = false;
+	this->depth_enable = true;
+#endif
+
+#ifdef TOYGL_ENABLE_3D
+	this->mesh_buffer = nullptr;
+	this->mesh_size = 0;
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	set_texture_src( nullptr, 0, 0 );
+	set_texture( false );
+	this->texture_deferred = false;
+	this->texture_perspective = false;
+	this->texture_dirty = false;
+
+	// no valid key has a unit of zero
+	memset( this->texture_cache, 0, sizeof( this->texture_cache ) );
+#endif
+
+}
+
+inline tgl::renderer* tgl::renderer::context() {
+#ifdef TOYGL_ENABLE_THREADS
+	// tile workers report the renderer the placers were registered with
+	return owner ? owner : this;
+#else
+	return this;
+#endif
+}
+
+tgl::renderer::~renderer() {
+#ifdef TOYGL_ENABLE_THREADS
+	set_threads( 0 );
+#endif
+
+	free( this->span_buffer );
+	if( this->target_owned ) free( this->target );
+
+#ifdef TOYGL_ENABLE_3D
+	free( this->mesh_buffer );
+#endif
+
+#ifdef TOYGL_ENABLE_DEPTH
+	free( this->depth_buffer );
+	free( this->hiz_buffer );
+	free( this->hiz_dirty );
+	free( this->hiz_frame );
+#endif
+}
+
+#ifdef TOYGL_ENABLE_THREADS
+
+tgl::renderer::renderer( renderer* owner ):
+		width( owner->width ),
+		xo( owner->xo ),
+		height( owner->height ),
+		yo( owner->yo ),
+		wen( owner->wen ),
+		hen( owner->hen ),
+		channels( owner->channels ) {
+
+	this->placer = owner->placer;
+	this->spans = owner->spans;
+	this->span_buffer = (tgl::byte*) malloc( width * channels );
+	this->target = owner->target;
+	this->target_pitch = owner->target_pitch;
+	this->col = owner->col;
+
+	init_state();
+
+	this->owner = owner;
+	this->tiles_x = 0;
+	this->tiles_y = 0;
+
+#ifdef TOYGL_ENABLE_DEPTH
+	this->depth_buffer = owner->depth_buffer;
+	this->hiz_buffer = owner->hiz_buffer;
+	this->hiz_dirty = owner->hiz_dirty;
+	this->hiz_width = owner->hiz_width;
+	this->hiz_frame = owner->hiz_frame;
+	this->depth_frame = owner->depth_frame;
+#endif
+
+}
+
+void tgl::renderer::set_threads( uint count ) {
+
+	if( !threads.empty() ) {
+
+		{
+			std::lock_guard<std::mutex> lock( tile_mutex );
+			tile_stop = true;
+		}
+
+		tile_start.notify_all();
+
+		for( uint i = 0; i < threads.size(); i ++ ) {
+			threads[i].join();
+		}
+
+		threads.clear();
+		tile_stop = false;
+
+		// new threads start waiting for frame 1
+		tile_frame = 0;
+
+	}
+
+	for( uint i = 0; i < workers.size(); i ++ ) {
+
+#ifdef TOYGL_ENABLE_DEPTH
+		// depth buffers are owned by this renderer
+		workers[i]->depth_buffer = nullptr;
+		workers[i]->hiz_buffer = nullptr;
+		workers[i]->hiz_dirty = nullptr;
+		workers[i]->hiz_frame = nullptr;
+#endif
+
+		delete workers[i];
+	}
+
+	workers.clear();
+
+	for( uint i = 0; i < count; i ++ ) {
+		workers.push_back( new renderer( this ) );
+	}
+
+	for( uint i = 0; i < count; i ++ ) {
+		threads.push_back( std::thread( &renderer::tile_loop, this, i ) );
+	}
+
+}
+
+void tgl::renderer::begin_tiles() {
+	binning = !workers.empty();
+}
+
+void tgl::renderer::end_tiles() {
+
+	binning = false;
+	if( bin.empty() ) return;
+
+	for( uint i = 0; i < tiles.size(); i ++ ) {
+		tiles[i].clear();
+	}
+
+	// add every triangle to the list of each tile its bounding box touches
+	for( uint i = 0; i < bin.size(); i ++ ) {
+
+		bin_triangle& t = bin[i];
+
+		const int shift = t.subpixel ? TOYGL_SUBPIXEL_BITS : 0;
+		const int xmax = tgl::math::max( t.v1.x, t.v2.x, t.v3.x ) >> shift;
+		const int xmin = tgl::math::min( t.v1.x, t.v2.x, t.v3.x ) >> shift;
+		const int ymax = tgl::math::max( t.v1.y, t.v2.y, t.v3.y ) >> shift;
+		const int ymin = tgl::math::min( t.v1.y, t.v2.y, t.v3.y ) >> shift;
+
+		if( xmax < 0 || ymax < 0 || xmin > wen || ymin > hen ) continue;
+
+		const int tx1 = tgl::math::max_clamp( xmax, wen ) / TOYGL_TILE_SIZE;
+		const int tx0 = tgl::math::max_clamp( xmin, wen ) / TOYGL_TILE_SIZE;
+		const int ty1 = tgl::math::max_clamp( ymax, hen ) / TOYGL_TILE_SIZE;
+		const int ty0 = tgl::math::max_clamp( ymin, hen ) / TOYGL_TILE_SIZE;
+
+		for( int ty = ty0; ty <= ty1; ty ++ ) {
+			for( int tx = tx0; tx <= tx1; tx ++ ) {
+				tiles[ty * tiles_x + tx].push_back( i );
+			}
+		}
+
+	}
+
+	// workers use the current output configuration
+	for( uint i = 0; i < workers.size(); i ++ ) {
+		workers[i]->placer = placer;
+		workers[i]->spans = spans;
+		workers[i]->target = target;
+		workers[i]->target_pitch = target_pitch;
+
+#ifdef TOYGL_ENABLE_DEPTH
+		workers[i]->depth_frame = depth_frame;
+#endif
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( tile_mutex );
+		tile_next = 0;
+		tile_done = 0;
+		tile_frame ++;
+	}
+
+	tile_start.notify_all();
+
+	{
+		std::unique_lock<std::mutex> lock( tile_mutex );
+		tile_end.wait( lock, [this] () { return tile_done == workers.size(); } );
+	}
+
+	bin.clear();
+
+}
+
+void tgl::renderer::tile_loop( uint id ) {
+
+	renderer* worker = workers[id];
+	uint frame = 0;
+
+	while( true ) {
+
+		{
+			std::unique_lock<std::mutex> lock( tile_mutex );
+			tile_start.wait( lock, [this, frame] () { return tile_stop || tile_frame != frame; } );
+
+			if( tile_stop ) return;
+			frame = tile_frame;
+		}
+
+		// tiles are handed out one at a time, until none are left
+		for( uint tile = tile_next ++; tile < tiles.size(); tile = tile_next ++ ) {
+			draw_tile( worker, tile );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( tile_mutex );
+			tile_done ++;
+		}
+
+		tile_end.notify_one();
+
+	}
+
+}
+
+void tgl::renderer::draw_tile( renderer* worker, uint tile ) {
+
+	std::vector<uint>& list = tiles[tile];
+
+	worker->clip_x0 = (tile % tiles_x) * TOYGL_TILE_SIZE;
+	worker->clip_y0 = (tile / tiles_x) * TOYGL_TILE_SIZE;
+	worker->clip_x1 = std::min( worker->clip_x0 + TOYGL_TILE_SIZE - 1, wen );
+	worker->clip_y1 = std::min( worker->clip_y0 + TOYGL_TILE_SIZE - 1, hen );
+
+	for( uint i = 0; i < list.size(); i ++ ) {
+		bin_triangle& t = bin[list[i]];
+
+		t.apply( worker );
+		worker->raster_triangle( t.v1, t.v2, t.v3, t.subpixel );
+	}
+
+}
+
+tgl::renderer::bin_triangle::bin_triangle( renderer* ctx, vec2i v1, vec2i v2, vec2i v3, bool subpixel ):
+		v1( v1 ),
+		v2( v2 ),
+		v3( v3 )
+#ifdef TOYGL_ENABLE_TEXTURES
+		, texture_w( ctx->texture_w ),
+		texture_triangle( ctx->texture_triangle )
+#endif
+		{
+
+	this->subpixel = subpixel;
+	this->col = ctx->col;
+
+#ifdef TOYGL_ENABLE_DEPTH
+	this->depth = ctx->depth;
+	this->depth_dx = ctx->depth_dx;
+	this->depth_dy = ctx->depth_dy;
+	this->depth_pass = ctx->depth_pass;
+	this->depth_flag = ctx->depth_flag;
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	this->texture_flag = ctx->texture_flag;
+	this->texture_perspective = ctx->texture_perspective;
+	this->texture = ctx->texture;
+#endif
+
+}
+
+void tgl::renderer::bin_triangle::apply( renderer* ctx ) {
+
+	ctx->col = col;
+
+#ifdef TOYGL_ENABLE_DEPTH
+	ctx->depth = depth;
+	ctx->depth_dx = depth_dx;
+	ctx->depth_dy = depth_dy;
+	ctx->depth_pass = depth_pass;
+	ctx->depth_flag = depth_flag;
+#endif
+
+#ifdef TOYGL_ENABLE_TEXTURES
+	ctx->texture_flag = texture_flag;
+	ctx->texture_perspective = texture_perspective;
+	ctx->texture_w = texture_w;
+	ctx->texture = texture;
+	ctx->texture_triangle = texture_triangle;
+#endif
+
+}
+
+#endif
+
+tgl::vec3f::vec3f( float_tgl x, float_tgl y, float_tgl z ) {
+	this->x = x;
+	this->y = y;
+	this->z = z;
+}
+
+tgl::vec2f::vec2f() {
+	this->x = 0;
+	this->y = 0;
+}
+
+tgl::vec2f::vec2f( float_tgl x, float_tgl y ) {
+	this->x = x;
+	this->y = y;
+}
+
+tgl::vec2i::vec2i( int x, int y ) {
+	this->x = x;
+	this->y = y;
+}
+
+tgl::vec2f tgl::vec2i::f() {
+	return tgl::vec2f( x, y );
+}
+
+tgl::edge2i::edge2i( vec2i v1, vec2i v2, int shift ) {
+	this->a = ((long long) v1.y - v2.y) * (1LL << shift);
+	this->b = ((long long) v2.x - v1.x) * (1LL << shift);
+	this->c = (long long) v1.x * v2.y - (long long) v2.x * v1.y;
+}
+
+long long tgl::edge2i::at( int x, int y ) {
+	return a * x + b * y + c;
+}
+
+void tgl::edge2i::negate() {
+	a = -a;
+	b = -b;
+	c = -c;
+}
+
+void tgl::edge2i::top_left() {
+	// pixels exactly on the edge are only inside of left edges (inside is
+	// to the right) and top edges (horizontal, inside is below)
+	if( !(a > 0 || (a == 0 && b > 0)) ) c -= 1;
+}
+
+void tgl::edge2i::flip() {
+	// turns 'value < 0' into 'value >= 0'
+	a = -a;
+	b = -b;
+	c = -c - 1;
+}
+
+bool tgl::edge2i::span( int y, int& l, int& r ) {
+
+	const long long k = b * y + c;
+
+	// narrow [l, r] to the pixels where a * x + k >= 0
+	if( a > 0 ) {
+		const long long x = tgl::math::ceil_div( -k, a );
+		if( x > r ) return false;
+		if( x > l ) l = x;
+	}else if( a < 0 ) {
+		const long long x = tgl::math::floor_div( k, -a );
+		if( x < l ) return false;
+		if( x < r ) r = x;
+	}else if( k < 0 ) {
+		return false;
+	}
+
+	return true;
+
+}
+
+int tgl::edge2i::test( int x0, int y0, int x1, int y1 ) {
+
+	const long long value = at( x0, y0 );
+
+	// the extremes of a linear function over a rectangle are at its corners
+	const long long min = value + std::min( a, 0ll ) * (x1 - x0) + std::min( b, 0ll ) * (y1 - y0);
+	const long long max = value + std::max( a, 0ll ) * (x1 - x0) + std::max( b, 0ll ) * (y1 - y0);
+
+	// 1 if a * x + b * y + c >= 0 for the whole rectangle, -1 if for none of it, 0 otherwise
+	return min >= 0 ? 1 : (max < 0 ? -1 : 0);
+
+}
+
+tgl::vec3f tgl::mat3x3f::operator*( const vec3f& b ) {
+	return vec3f(
+
+		b.x * m00 + b.y * m01 + b.z * m02,
+		b.x * m10 + b.y * m11 + b.z * m12,
+		b.x * m20 + b.y * m21 + b.z * m22
+
+	);
+}
+
+tgl::mat3x3f tgl::mat3x3f::operator*( const mat3x3f& b ) {
+	return mat3x3f {
+
+		b.m00 * m00 + b.m10 * m01 + b.m20 * m02,
+		b.m01 * m00 + b.m11 * m01 + b.m21 * m02,
+		b.m02 * m00 + b.m12 * m01 + b.m22 * m02,
+
+		b.m00 * m10 + b.m10 * m11 + b.m20 * m12,
+		b.m01 * m10 + b.m11 * m11 + b.m21 * m12,
+		b.m02 * m10 + b.m12 * m11 + b.m22 * m12,
+
+		b.m00 * m20 + b.m10 * m21 + b.m20 * m22,
+		b.m01 * m20 + b.m11 * m21 + b.m21 * m22,
+		b.m02 * m20 + b.m12 * m21 + b.m22 * m22,
+
+	};
+}
+
+tgl::trig2f::trig2f( vec2f v1, vec2f v2, vec2f v3 ) {
+	this->v1 = v1;
+	this->v2 = v2;
+	this->v3 = v3;
+}
+
+#ifdef TOYGL_ENABLE_TEXTURES
+tgl::texture::texture() {
+	this->data = nullptr;
+	this->width = 0;
+	this->height = 0;
+	this->xmax = -1;
+	this->ymax = -1;
+	this->shift = 0;
+	this->pow2 = false;
+	this->wrap = tgl::wrap::clamp;
+	this->filter = tgl::filter::nearest;
+	this->tiled = false;
+	this->mips = nullptr;
+	this->levels = 0;
+	this->palette = nullptr;
+	this->bits = 0;
+	this->compressed = false;
+	this->cache_block = (uint) -1;
+}
+
+tgl::texture::texture( tgl::byte* data, uint width, uint height, byte wrap, byte filter ) {
+	this->data = data;
+	this->width = width;
+	this->height = height;
+	this->xmax = width - 1;
+	this->ymax = height - 1;
+	this->shift = 0;
+	this->pow2 = width && height && !(width & (width - 1)) && !(height & (height - 1));
+	this->wrap = wrap;
+	this->filter = filter;
+	this->tiled = false;
+	this->mips = nullptr;
+	this->levels = 0;
+	this->palette = nullptr;
+	this->bits = 0;
+	this->compressed = false;
+	this->cache_block = (uint) -1;
+
+	while( (1u << shift) < width ) shift ++;
+}
+
+tgl::texture::texture( tgl::byte* data, uint width, uint height, tgl::byte* palette, byte bits, byte wrap, byte filter ): texture( data, width, height, wrap, filter ) {
+	this->palette = palette;
+	this->bits = bits;
+}
+
+bool tgl::texture::tile( tgl::byte* buffer, uint channels ) {
+
+	// only whole blocks of whole texels are supported
+	if( tiled || bits || width % 4 != 0 || height % 4 != 0 ) return false;
 
-		for( int y = ymax; y >= ymin; y -- ) {
+	tiled = true;
 
-			const int py = (y - pos.y) * (y - pos.y);
+	for( uint v = 0; v < height; v ++ ) {
+		for( uint u = 0; u < width; u ++ ) {
+			memcpy( buffer + offset( u, v ) * channels, data + (v * width + u) * channels, channels );
+		}
+	}
 
-			// simplified distance check
-			if( (x - pos.x) * (x - pos.x) + py <= powr ) {
+	data = buffer;
+	return true;
 
-				draw_pixel( x, y );
-				painted = true;
+}
 
-			}else if( painted ) {
-				break;
-			}
+static inline uint __toygl_rgb565( tgl::byte* c ) {
+	return ((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255);
+}
 
-		}
-	}
+static inline void __toygl_rgb888( uint c, tgl::byte* out ) {
+	const uint r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
 
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
 }
 
-void tgl::renderer::draw_glyph( uint x, uint y, const byte* glyph, unsigned int scale ) {
+bool tgl::texture::compress( tgl::byte* buffer, uint channels ) {
 
-	if( x > (uint) wen || y > (uint) hen ) return;
+	// only whole blocks of at most 4 channels (the 4th is not stored) are supported
+	if( compressed || channels < 3 || channels > 4 || width % 4 != 0 || height % 4 != 0 ) return false;
 
-	for( int gx = 0; gx < 8; gx ++ ) {
-		const unsigned int bit = 1 << gx;
+	tgl::byte* out = buffer;
 
-		for( int gy = 0; gy < 8; gy ++ ) {
-			if( glyph[gy] & bit ) {
+	for( uint by = 0; by < height; by += 4 ) {
+		for( uint bx = 0; bx < width; bx += 4 ) {
 
-				if( scale == 1 ) {
-					draw_unsafe_pixel( x + gx, y + gy );
-				}else{
-					const int sx = x + gx * scale;
-					const int sy = y + gy * scale;
-					draw_square( vec2i(sx, sy), vec2i(sx + scale - 1, sy + scale - 1) );
-				}
+			tgl::byte* texels[16];
+			tgl::byte lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
 
-			}
-		}
-	}
+			// the endpoints are the corners of the bounding box of the block's colors
+			for( uint i = 0; i < 16; i ++ ) {
+				texels[i] = texel( offset( bx + (i & 3), by + (i >> 2) ), channels );
 
-}
+				for( uint c = 0; c < 3; c ++ ) {
+					lo[c] = std::min( lo[c], texels[i][c] );
+					hi[c] = std::max( hi[c], texels[i][c] );
+				}
+			}
 
-void tgl::renderer::draw_string( uint x, uint y, const char* text, const byte font[][8], unsigned int scale, int vs, int hs, int fmax, bool special ) {
+			uint c0 = __toygl_rgb565( hi );
+			uint c1 = __toygl_rgb565( lo );
+			uint indices = 0;
 
-	if( x > (uint) wen || y > (uint) hen ) return;
+			// c0 > c1 selects the 4 color mode
+			if( c0 < c1 ) std::swap( c0, c1 );
 
-	const uint x0 = x;
+			if( c0 != c1 ) {
 
-	for( int i = 0; true; i ++ ) {
+				tgl::byte colors[4][3];
+				__toygl_rgb888( c0, colors[0] );
+				__toygl_rgb888( c1, colors[1] );
 
-		const char chr = text[i];
-		if( chr != '\0' ) {
+				for( uint c = 0; c < 3; c ++ ) {
+					colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+					colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+				}
 
-			if( (byte) chr > fmax ) continue;
+				// every texel takes the closest of the 4 colors
+				for( uint i = 0; i < 16; i ++ ) {
+					uint best = 0, best_error = (uint) -1;
 
-			draw_glyph( x, y, (byte*) font[ (int) chr ], scale );
+					for( uint j = 0; j < 4; j ++ ) {
+						uint error = 0;
 
-			if( special ) {
+						for( uint c = 0; c < 3; c ++ ) {
+							const int d = texels[i][c] - colors[j][c];
+							error += d * d;
+						}
 
-				if( chr == '\n' ) {
-					y += 8 + vs;
-					continue;
-				}
+						if( error < best_error ) {
+							best = j;
+							best_error = error;
+						}
+					}
 
-				if( chr == '\r' ) {
-					x = x0;
-					continue;
+					indices |= best << (i * 2);
 				}
 
 			}
 
-			x += 8 * scale + hs;
-
-		}else break;
+			out[0] = c0; out[1] = c0 >> 8;
+			out[2] = c1; out[3] = c1 >> 8;
+			out[4] = indices; out[5] = indices >> 8; out[6] = indices >> 16; out[7] = indices >> 24;
+			out += 8;
 
+		}
 	}
 
+	// blocks are addressed just like 4x4 tiles
+	data = buffer;
+	palette = nullptr;
+	bits = 0;
+	tiled = true;
+	compressed = true;
+	cache_block = (uint) -1;
+
+	return true;
+
 }
 
-void tgl::renderer::draw_triangle( vec2i v1, vec2i v2, vec2i v3 ) {
+void tgl::texture::decode_block( uint block, uint channels ) {
 
-	const int xmax = tgl::math::max_clamp( tgl::math::max( v1.x, v2.x, v3.x ), wen );
-	const int xmin = tgl::math::max_clamp( tgl::math::min( v1.x, v2.x, v3.x ), wen );
-	const int ymax = tgl::math::max_clamp( tgl::math::max( v1.y, v2.y, v3.y ), hen );
-	const int ymin = tgl::math::max_clamp( tgl::math::min( v1.y, v2.y, v3.y ), hen );
+	tgl::byte* in = data + block * 8;
+	const uint c0 = in[0] | in[1] << 8;
+	const uint c1 = in[2] | in[3] << 8;
+	const uint indices = in[4] | in[5] << 8 | in[6] << 16 | (uint) in[7] << 24;
 
-#ifdef TOYGL_ENABLE_TEXTURES
-	if( texture_flag ) texture_matrix = triangle_mapping_matrix( trig2f( v1.f(), v2.f(), v3.f() ), texture_triangle );
-#endif
+	tgl::byte colors[4][4];
+	__toygl_rgb888( c0, colors[0] );
+	__toygl_rgb888( c1, colors[1] );
 
-	for( int x = xmax; x >= xmin; x -- ) {
-		bool painted = false;
+	for( uint c = 0; c < 3; c ++ ) {
+		if( c0 > c1 ) {
+			colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+			colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+		}else{
+			colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+			colors[3][c] = 0;
+		}
+	}
 
-		for( int y = ymax; y >= ymin; y -- ) {
+	// the 4th channel is always opaque
+	colors[0][3] = colors[1][3] = colors[2][3] = colors[3][3] = 255;
 
-			// is point (x,y) inside given triangle?
-			const bool b1 = tgl::math::cross( x, y, v1.x, v1.y, v2.x, v2.y ) < 0;
-			const bool b2 = tgl::math::cross( x, y, v2.x, v2.y, v3.x, v3.y ) < 0;
+	for( uint i = 0; i < 16; i ++ ) {
+		memcpy( cache + i * channels, colors[(indices >> (i * 2)) & 3], channels );
+	}
 
-			if( b1 == b2 ) {
+	cache_block = block;
 
-				const bool b3 = tgl::math::cross( x, y, v3.x, v3.y, v1.x, v1.y ) < 0;
+}
 
-				if( b2 == b3 ) {
+bool tgl::texture::mipmap( tgl::byte* buffer, uint channels ) {
 
-#ifdef TOYGL_ENABLE_TEXTURES
-					if( texture_flag ){
+	// every level must be exactly half the size of the previous one
+	if( !pow2 ) return false;
 
-						// map pixel (x,y) to texture coordinates and quarry color
-						vec3f uv = texture_matrix * vec3f( x, y, 1 );
+	tgl::texture src = *this;
+	mips = buffer;
+	levels = 0;
 
-						const uint uvx = tgl::math::max_clamp( std::floor(uv.x), texture_width );
-						const uint uvy = tgl::math::max_clamp( std::floor(uv.y), texture_height );
+	while( src.width > 1 && src.height > 1 ) {
 
-						col = texture + (uvy * (texture_width + 1) + uvx) * channels;
+		tgl::texture dst( buffer, src.width / 2, src.height / 2, wrap );
 
-					}
-#endif
+		// each texel is the average of the 2x2 texels it covers
+		for( uint v = 0; v < dst.height; v ++ ) {
+			for( uint u = 0; u < dst.width; u ++ ) {
 
-					draw_pixel( x, y );
-					painted = true;
+				tgl::byte* t00 = src.texel( src.offset( u * 2, v * 2 ), channels );
+				tgl::byte* t01 = src.texel( src.offset( u * 2 + 1, v * 2 ), channels );
+				tgl::byte* t10 = src.texel( src.offset( u * 2, v * 2 + 1 ), channels );
+				tgl::byte* t11 = src.texel( src.offset( u * 2 + 1, v * 2 + 1 ), channels );
+				tgl::byte* out = dst.data + dst.offset( u, v ) * channels;
 
+				for( uint c = 0; c < channels; c ++ ) {
+					out[c] = (t00[c] + t01[c] + t10[c] + t11[c] + 2) / 4;
 				}
 
-			}else if( painted ) {
-				break;
 			}
-
 		}
+
+		buffer += dst.width * dst.height * channels;
+		levels ++;
+		src = dst;
+
 	}
 
+	return true;
+
 }
 
-void tgl::renderer::draw_image( uint x, uint y, tgl::byte* buffer, uint w, uint h, uint scale ) {
+uint tgl::texture::mipmap_size( uint channels ) {
 
-	if( x > (uint) wen || y > (uint) hen ) return;
+	uint size = 0;
 
-	const int xmax = tgl::math::max_clamp( x + w, wen );
-	const int ymax = tgl::math::max_clamp( y + h, hen );
+	for( uint w = width / 2, h = height / 2; w && h; w /= 2, h /= 2 ) {
+		size += w * h * channels;
+	}
 
-	for( int yc = y; yc < ymax; yc ++ ) {
-		col = buffer + yc * w * channels;
+	return size;
 
-		for( int xc = x; xc < xmax; xc ++ ) {
+}
 
-			if( scale == 1 ) {
-				draw_pixel( xc, yc );
-			}else{
-				const int sx = xc * scale;
-				const int sy = yc * scale;
-				draw_square( vec2i(sx, sy), vec2i(sx + scale - 1, sy + scale - 1) );
-			}
+tgl::texture tgl::texture::level( uint level, uint channels ) {
 
-			col += channels;
+	if( level == 0 ) return *this;
 
-		}
+	tgl::byte* buffer = mips;
+
+	for( uint i = 1; i < level; i ++ ) {
+		buffer += (width >> i) * (height >> i) * channels;
 	}
 
+	return tgl::texture( buffer, width >> level, height >> level, wrap, filter );
+
 }
 
-#ifdef TOYGL_ENABLE_TEXTURES
+inline uint tgl::texture::index( int u, int v ) {
+	wrap_coords( u, v );
+	return offset( u, v );
+}
 
-tgl::mat3x3f tgl::renderer::triangle_mapping_matrix( trig2f t1, trig2f t2 ) {
+inline void tgl::texture::wrap_coords( int& u, int& v ) {
+
+	if( wrap == tgl::wrap::repeat ) {
+		if( pow2 ) {
+			u &= xmax;
+			v &= ymax;
+		}else{
+			u %= (int) width;
+			v %= (int) height;
+			if( u < 0 ) u += width;
+			if( v < 0 ) v += height;
+		}
+	}else{
+		u = tgl::math::max_clamp( u, xmax );
+		v = tgl::math::max_clamp( v, ymax );
+	}
 
-	mat3x3f invm = {0};
+}
 
-	{
-		const mat3x3f m1 = {
-			t1.v1.x, t1.v2.x, t1.v3.x,
-			t1.v1.y, t1.v2.y, t1.v3.y,
-			1, 1, 1
-		};
+inline uint tgl::texture::offset( uint u, uint v ) {
 
-		if( !tgl::math::invert_matrix( m1, invm ) ) return mat3x3f {0};
+	// neighbouring texels in both directions share a block (and so a cache line)
+	if( tiled ) {
+		const uint block = pow2 ? ((v >> 2) << (shift - 2)) + (u >> 2) : (v >> 2) * (width >> 2) + (u >> 2);
+		return (block << 4) + ((v & 3) << 2) + (u & 3);
 	}
 
-	mat3x3f m2 = {
-		t2.v1.x, t2.v2.x, t2.v3.x,
-		t2.v1.y, t2.v2.y, t2.v3.y,
-		1, 1, 1
-	};
-
-	return m2 * invm;
+	return pow2 ? (v << shift) + u : v * width + u;
 
 }
 
-#endif
-
-#ifdef TOYGL_ENABLE_3D
+inline tgl::byte* tgl::texture::texel( uint offset, uint channels ) {
 
-void tgl::renderer::project_vector( vec3f& vec ) {
+	// 4 bit indices are packed two per byte, the first one in the low half
+	if( bits == 8 ) return palette + data[offset] * channels;
+	if( bits == 4 ) return palette + ((data[offset >> 1] >> ((offset & 1) << 2)) & 15) * channels;
 
-	vec.x -= cam.x;
-	vec.y -= cam.y;
-	vec.z -= cam.z;
+	// neighbouring texels usually share a block, so it is decoded only once
+	if( compressed ) {
+		if( (offset >> 4) != cache_block ) decode_block( offset >> 4, channels );
+		return cache + (offset & 15) * channels;
+	}
 
-	vec.x *= scale;
-	vec.y *= scale;
-	vec.z *= scale;
+	return data + offset * channels;
 
-	const float a = rzs * vec.y + rzc * vec.x;
-	const float b = rzc * vec.y - rzs * vec.x;
-	const float c = ryc * vec.z + rys * a;
+}
+#endif
 
-	vec.x = ryc * a - rys * vec.z;
-	vec.y = rxs * c + rxc * b;
-	vec.z = rxc * c - rxs * b;
+#if defined(TOYGL_SIMD_WIDTH) && defined(TOYGL_ENABLE_TEXTURES)
+static inline uint __toygl_bilinear( __m128i top, __m128i bottom, int fx, int fy ) {
 
-	const float d = vec.z + dist, m = width / (d * fov);
-	vec.x *= m;
-	vec.y *= m;
+	// same steps as the scalar blend, with channels widened to 16 bits
+	// and the left texels in the low half, no product exceeds 255 * 256
+	const __m128i column = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( top, _mm_set1_epi16( 256 - fy ) ), _mm_mullo_epi16( bottom, _mm_set1_epi16( fy ) ) ), 8 );
+	const __m128i row = _mm_mullo_epi16( column, _mm_set_epi16( fx, fx, fx, fx, 256 - fx, 256 - fx, 256 - fx, 256 - fx ) );
+	const __m128i sum = _mm_srli_epi16( _mm_add_epi16( row, _mm_srli_si128( row, 8 ) ), 8 );
 
-	vec.z = d * (255.0f / far);
-	vec.x += xo;
-	vec.y += yo;
+	return _mm_cvtsi128_si32( _mm_packus_epi16( sum, sum ) );
 
 }
 
-void tgl::renderer::draw_3d_line( vec3f v1, vec3f v2 ) {
+inline uint tgl::simd::bilinear( const uint* t, int fx, int fy ) {
 
-	project_vector( v1 );
-	project_vector( v2 );
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i top = _mm_unpacklo_epi8( _mm_unpacklo_epi32( _mm_cvtsi32_si128( t[0] ), _mm_cvtsi32_si128( t[1] ) ), zero );
+	const __m128i bottom = _mm_unpacklo_epi8( _mm_unpacklo_epi32( _mm_cvtsi32_si128( t[2] ), _mm_cvtsi32_si128( t[3] ) ), zero );
 
-	TOYGL_DEPTH( this, (v1.z + v2.z) * 0.5f, {
+	return __toygl_bilinear( top, bottom, fx, fy );
 
-		vec2i p1( std::round(v1.x), std::round(v1.y) );
-		vec2i p2( std::round(v2.x), std::round(v2.y) );
+}
 
-		draw_line( p1, p2 );
+inline uint tgl::simd::bilinear_rows( const tgl::byte* top, const tgl::byte* bottom, uint channels, int fx, int fy ) {
 
-	} );
+	// 8 bytes hold both texels of a row
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) top ), zero );
+	__m128i b = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) bottom ), zero );
 
-}
+	// move the right texels of 3 channel rows to the high half,
+	// the unused fourth channel is never stored
+	if( channels == 3 ) {
+		a = _mm_unpacklo_epi64( a, _mm_srli_si128( a, 6 ) );
+		b = _mm_unpacklo_epi64( b, _mm_srli_si128( b, 6 ) );
+	}
 
-void tgl::renderer::draw_3d_triangle( vec3f v1, vec3f v2, vec3f v3 ) {
+	return __toygl_bilinear( a, b, fx, fy );
 
-	project_vector( v1 );
-	project_vector( v2 );
-	project_vector( v3 );
+}
+#endif
 
-	TOYGL_DEPTH( this, (v1.z + v2.z + v3.z) * 0.33f, {
+#if TOYGL_SIMD_WIDTH == 8
 
-		if (v1.z <= near || v2.z <= near || v3.z <= near || v1.z > far || v2.z > far || v3.z > far) return;
+#ifdef TOYGL_ENABLE_DEPTH16
+static inline __m256i __toygl_depth_value( float depth, float step, int x ) {
+	const __m256 d = _mm256_add_ps( _mm256_set1_ps( depth ), _mm256_mul_ps( _mm256_set1_ps( step ), _mm256_add_ps( _mm256_set1_ps( x ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) ) ) );
 
-		vec2f a( v2.x - v1.x, v2.y - v1.y );
-		vec2f b( v3.x - v1.x, v3.y - v1.y );
+	// same conversion as tgl::math::depth_value
+	return _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_mul_ps( d, _mm256_set1_ps( 256 ) ), _mm256_setzero_ps() ), _mm256_set1_ps( 65535 ) ) );
+}
+#endif
 
-		// check normal
-		if( (a.x * b.y - a.y * b.x) >= 0 ) {
+uint tgl::simd::depth_test( depth_tgl* row, float depth, float step, int x ) {
+#ifdef TOYGL_ENABLE_DEPTH16
+	const __m256i q = __toygl_depth_value( depth, step, x );
+	const __m256i z = _mm256_cvtepu16_epi32( _mm_loadu_si128( (__m128i*) row ) );
+	const __m256i pass = _mm256_cmpgt_epi32( z, q );
 
-			vec2i p1( std::round(v1.x), std::round(v1.y) );
-			vec2i p2( std::round(v2.x), std::round(v2.y) );
-			vec2i p3( std::round(v3.x), std::round(v3.y) );
+	// pack works within 128 bit lanes, so move the halves together
+	const __m256i r = _mm256_blendv_epi8( z, q, pass );
+	_mm_storeu_si128( (__m128i*) row, _mm256_castsi256_si128( _mm256_permute4x64_epi64( _mm256_packus_epi32( r, r ), 0x08 ) ) );
+	return _mm256_movemask_ps( _mm256_castsi256_ps( pass ) );
+#else
+	const __m256 d = _mm256_add_ps( _mm256_set1_ps( depth ), _mm256_mul_ps( _mm256_set1_ps( step ), _mm256_add_ps( _mm256_set1_ps( x ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) ) ) );
+	const __m256 z = _mm256_loadu_ps( row );
+	const __m256 pass = _mm256_cmp_ps( z, d, _CMP_GT_OQ );
 
-			draw_triangle( p1, p2, p3 );
+	_mm256_storeu_ps( row, _mm256_blendv_ps( z, d, pass ) );
+	return _mm256_movemask_ps( pass );
+#endif
+}
 
-		}
+uint tgl::simd::depth_equal( depth_tgl* row, float depth, float step, int x ) {
+#ifdef TOYGL_ENABLE_DEPTH16
+	const __m256i q = __toygl_depth_value( depth, step, x );
+	const __m256i z = _mm256_cvtepu16_epi32( _mm_loadu_si128( (__m128i*) row ) );
 
-	} );
+	return _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( z, q ) ) );
+#else
+	const __m256 d = _mm256_add_ps( _mm256_set1_ps( depth ), _mm256_mul_ps( _mm256_set1_ps( step ), _mm256_add_ps( _mm256_set1_ps( x ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) ) ) );
 
+	return _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( row ), d, _CMP_EQ_OQ ) );
+#endif
 }
 
-// Deprecated
-void tgl::renderer::draw_3d_cube( vec3f v ) {
+#if defined(TOYGL_ENABLE_TEXTURES) && !defined(TOYGL_ENABLE_DOUBLE)
+void tgl::simd::texture_coords( mat3x3f& m, int x, int y, tgl::texture& texture, int* u, int* v ) {
+	const __m256 xs = _mm256_add_ps( _mm256_set1_ps( x ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) );
 
-	draw_3d_triangle( vec3f(v.x - 1, v.y - 1, v.z + 1), vec3f(v.x - 1, v.y + 1, v.z + 1), vec3f(v.x + 1, v.y - 1, v.z + 1) );
-	draw_3d_triangle( vec3f(v.x + 1, v.y + 1, v.z + 1), vec3f(v.x + 1, v.y - 1, v.z + 1), vec3f(v.x - 1, v.y + 1, v.z + 1) );
-	draw_3d_triangle( vec3f(v.x - 1, v.y - 1, v.z - 1), vec3f(v.x + 1, v.y - 1, v.z - 1), vec3f(v.x - 1, v.y + 1, v.z - 1) );
-	draw_3d_triangle( vec3f(v.x + 1, v.y + 1, v.z - 1), vec3f(v.x - 1, v.y + 1, v.z - 1), vec3f(v.x + 1, v.y - 1, v.z - 1) );
-	draw_3d_triangle( vec3f(v.x + 1, v.y - 1, v.z - 1), vec3f(v.x + 1, v.y - 1, v.z + 1), vec3f(v.x + 1, v.y + 1, v.z - 1) );
-	draw_3d_triangle( vec3f(v.x + 1, v.y + 1, v.z + 1), vec3f(v.x + 1, v.y + 1, v.z - 1), vec3f(v.x + 1, v.y - 1, v.z + 1) );
-	draw_3d_triangle( vec3f(v.x - 1, v.y - 1, v.z - 1), vec3f(v.x - 1, v.y + 1, v.z - 1), vec3f(v.x - 1, v.y - 1, v.z + 1) );
-	draw_3d_triangle( vec3f(v.x - 1, v.y + 1, v.z + 1), vec3f(v.x - 1, v.y - 1, v.z + 1), vec3f(v.x - 1, v.y + 1, v.z - 1) );
-	draw_3d_triangle( vec3f(v.x - 1, v.y + 1, v.z - 1), vec3f(v.x + 1, v.y + 1, v.z - 1), vec3f(v.x - 1, v.y + 1, v.z + 1) );
-	draw_3d_triangle( vec3f(v.x + 1, v.y + 1, v.z + 1), vec3f(v.x - 1, v.y + 1, v.z + 1), vec3f(v.x + 1, v.y + 1, v.z - 1) );
-	draw_3d_triangle( vec3f(v.x - 1, v.y - 1, v.z - 1), vec3f(v.x - 1, v.y - 1, v.z + 1), vec3f(v.x + 1, v.y - 1, v.z - 1) );
-	draw_3d_triangle( vec3f(v.x + 1, v.y - 1, v.z + 1), vec3f(v.x + 1, v.y - 1, v.z - 1), vec3f(v.x - 1, v.y - 1, v.z + 1) );
+	// same operations (and order) as mat3x3f * vec3f( x, y, 1 )
+	const __m256 fu = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( xs, _mm256_set1_ps( m.m00 ) ), _mm256_set1_ps( y * m.m01 ) ), _mm256_set1_ps( m.m02 ) );
+	const __m256 fv = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( xs, _mm256_set1_ps( m.m10 ) ), _mm256_set1_ps( y * m.m11 ) ), _mm256_set1_ps( m.m12 ) );
 
-}
+	const __m256i iu = _mm256_cvttps_epi32( _mm256_floor_ps( fu ) );
+	const __m256i iv = _mm256_cvttps_epi32( _mm256_floor_ps( fv ) );
+	const __m256i xmax = _mm256_set1_epi32( texture.xmax );
+	const __m256i ymax = _mm256_set1_epi32( texture.ymax );
 
+	if( texture.wrap == tgl::wrap::repeat ) {
+		_mm256_storeu_si256( (__m256i*) u, _mm256_and_si256( iu, xmax ) );
+		_mm256_storeu_si256( (__m256i*) v, _mm256_and_si256( iv, ymax ) );
+	}else{
+		const __m256i zero = _mm256_setzero_si256();
+		_mm256_storeu_si256( (__m256i*) u, _mm256_min_epi32( _mm256_max_epi32( iu, zero ), xmax ) );
+		_mm256_storeu_si256( (__m256i*) v, _mm256_min_epi32( _mm256_max_epi32( iv, zero ), ymax ) );
+	}
+}
 #endif
 
-tgl::renderer::renderer( uint x, uint y, pixel_placer placer, byte _channels ):
-		width( x ),
-		xo( x >> 1 ),
-		height( y ),
-		yo( y >> 1 ),
-		wen( x - 1 ),
-		hen( y - 1 ),
-		channels( _channels ) {
+#if defined(TOYGL_ENABLE_3D) && !defined(TOYGL_ENABLE_DOUBLE)
+void tgl::simd::project( float* xs, float* ys, float* zs, const float* p ) {
+	const __m256 s = _mm256_set1_ps( p[3] );
 
-	this->placer = placer;
-	this->col = _channels == 3 ? tgl::rgb::black : nullptr;
+	// same operations (and order) as renderer::project_vector
+	const __m256 x = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( xs ), _mm256_set1_ps( p[0] ) ), s );
+	const __m256 y = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( ys ), _mm256_set1_ps( p[1] ) ), s );
+	const __m256 z = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( zs ), _mm256_set1_ps( p[2] ) ), s );
 
-#ifdef TOYGL_ENABLE_DEPTH
-	this->depth_buffer = (float*) malloc( x * y * sizeof( float ) );
-	this->depth = 0;
-	this->depth_flag = false;
-	this->depth_enable = true;
-#endif
+	const __m256 rzc = _mm256_set1_ps( p[4] ), rzs = _mm256_set1_ps( p[5] );
+	const __m256 ryc = _mm256_set1_ps( p[6] ), rys = _mm256_set1_ps( p[7] );
+	const __m256 rxc = _mm256_set1_ps( p[8] ), rxs = _mm256_set1_ps( p[9] );
 
-#ifdef TOYGL_ENABLE_3D
-	set_rotation( vec3f(0, 0, 0) );
-	set_camera( vec3f(0, 0, 0) );
-	set_distance( 10 );
-	set_fov( 80 );
-	set_clip( 1, 255 );
-	set_scale( 1 );
-#endif
+	const __m256 a = _mm256_add_ps( _mm256_mul_ps( rzs, y ), _mm256_mul_ps( rzc, x ) );
+	const __m256 b = _mm256_sub_ps( _mm256_mul_ps( rzc, y ), _mm256_mul_ps( rzs, x ) );
+	const __m256 c = _mm256_add_ps( _mm256_mul_ps( ryc, z ), _mm256_mul_ps( rys, a ) );
 
-#ifdef TOYGL_ENABLE_TEXTURES
-	set_texture_src( nullptr, 0, 0 );
-	set_texture( false );
+	const __m256 rx = _mm256_sub_ps( _mm256_mul_ps( ryc, a ), _mm256_mul_ps( rys, z ) );
+	const __m256 ry = _mm256_add_ps( _mm256_mul_ps( rxs, c ), _mm256_mul_ps( rxc, b ) );
+	const __m256 rz = _mm256_sub_ps( _mm256_mul_ps( rxc, c ), _mm256_mul_ps( rxs, b ) );
+
+	const __m256 d = _mm256_add_ps( rz, _mm256_set1_ps( p[10] ) );
+	const __m256 m = _mm256_div_ps( _mm256_set1_ps( p[12] ), _mm256_mul_ps( d, _mm256_set1_ps( p[11] ) ) );
+
+	_mm256_storeu_ps( xs, _mm256_add_ps( _mm256_mul_ps( rx, m ), _mm256_set1_ps( p[14] ) ) );
+	_mm256_storeu_ps( ys, _mm256_add_ps( _mm256_mul_ps( ry, m ), _mm256_set1_ps( p[15] ) ) );
+	_mm256_storeu_ps( zs, _mm256_mul_ps( d, _mm256_set1_ps( p[13] ) ) );
+}
 #endif
 
+#elif TOYGL_SIMD_WIDTH == 4
+
+#ifdef TOYGL_ENABLE_DEPTH16
+static inline __m128i __toygl_depth_value( float depth, float step, int x ) {
+	const __m128 d = _mm_add_ps( _mm_set1_ps( depth ), _mm_mul_ps( _mm_set1_ps( step ), _mm_add_ps( _mm_set1_ps( x ), _mm_setr_ps( 0, 1, 2, 3 ) ) ) );
+
+	// same conversion as tgl::math::depth_value
+	return _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( d, _mm_set1_ps( 256 ) ), _mm_setzero_ps() ), _mm_set1_ps( 65535 ) ) );
 }
+#endif
 
-tgl::renderer::~renderer() {
-#ifdef TOYGL_ENABLE_DEPTH
-	free( this->depth_buffer );
+uint tgl::simd::depth_test( depth_tgl* row, float depth, float step, int x ) {
+#ifdef TOYGL_ENABLE_DEPTH16
+	const __m128i q = __toygl_depth_value( depth, step, x );
+	const __m128i z = _mm_unpacklo_epi16( _mm_loadl_epi64( (__m128i*) row ), _mm_setzero_si128() );
+	const __m128i pass = _mm_cmpgt_epi32( z, q );
+	const __m128i r = _mm_or_si128( _mm_and_si128( pass, q ), _mm_andnot_si128( pass, z ) );
+
+	// SSE2 can only pack signed values, so shift them to the signed range and back
+	const __m128i packed = _mm_packs_epi32( _mm_sub_epi32( r, _mm_set1_epi32( 0x8000 ) ), _mm_setzero_si128() );
+	_mm_storel_epi64( (__m128i*) row, _mm_xor_si128( packed, _mm_set1_epi16( (short) 0x8000 ) ) );
+	return _mm_movemask_ps( _mm_castsi128_ps( pass ) );
+#else
+	const __m128 d = _mm_add_ps( _mm_set1_ps( depth ), _mm_mul_ps( _mm_set1_ps( step ), _mm_add_ps( _mm_set1_ps( x ), _mm_setr_ps( 0, 1, 2, 3 ) ) ) );
+	const __m128 z = _mm_loadu_ps( row );
+	const __m128 pass = _mm_cmpgt_ps( z, d );
+
+	_mm_storeu_ps( row, _mm_or_ps( _mm_and_ps( pass, d ), _mm_andnot_ps( pass, z ) ) );
+	return _mm_movemask_ps( pass );
 #endif
 }
 
-tgl::vec3f::vec3f( float_tgl x, float_tgl y, float_tgl z ) {
-	this->x = x;
-	this->y = y;
-	this->z = z;
-}
+uint tgl::simd::depth_equal( depth_tgl* row, float depth, float step, int x ) {
+#ifdef TOYGL_ENABLE_DEPTH16
+	const __m128i q = __toygl_depth_value( depth, step, x );
+	const __m128i z = _mm_unpacklo_epi16( _mm_loadl_epi64( (__m128i*) row ), _mm_setzero_si128() );
 
-tgl::vec2f::vec2f() {
-	this->x = 0;
-	this->y = 0;
-}
+	return _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( z, q ) ) );
+#else
+	const __m128 d = _mm_add_ps( _mm_set1_ps( depth ), _mm_mul_ps( _mm_set1_ps( step ), _mm_add_ps( _mm_set1_ps( x ), _mm_setr_ps( 0, 1, 2, 3 ) ) ) );
 
-tgl::vec2f::vec2f( float_tgl x, float_tgl y ) {
-	this->x = x;
-	this->y = y;
+	return _mm_movemask_ps( _mm_cmpeq_ps( _mm_loadu_ps( row ), d ) );
+#endif
 }
 
-tgl::vec2i::vec2i( int x, int y ) {
-	this->x = x;
-	this->y = y;
+#if defined(TOYGL_ENABLE_TEXTURES) && !defined(TOYGL_ENABLE_DOUBLE)
+static inline __m128i __toygl_floor( __m128 f ) {
+
+	// SSE2 has no floor, so truncate and correct negative values
+	__m128 t = _mm_cvtepi32_ps( _mm_cvttps_epi32( f ) );
+	t = _mm_sub_ps( t, _mm_and_ps( _mm_cmpgt_ps( t, f ), _mm_set1_ps( 1 ) ) );
+
+	return _mm_cvttps_epi32( t );
+
 }
 
-tgl::vec2f tgl::vec2i::f() {
-	return tgl::vec2f( x, y );
+static inline __m128i __toygl_clamp( __m128i i, __m128i max ) {
+
+	// SSE2 has no signed 32 bit min/max, so mask values outside of [0, max]
+	i = _mm_and_si128( i, _mm_cmpgt_epi32( i, _mm_setzero_si128() ) );
+
+	const __m128i over = _mm_cmpgt_epi32( i, max );
+	return _mm_or_si128( _mm_andnot_si128( over, i ), _mm_and_si128( over, max ) );
+
 }
 
-tgl::vec3f tgl::mat3x3f::operator*( const vec3f& b ) {
-	return vec3f(
+void tgl::simd::texture_coords( mat3x3f& m, int x, int y, tgl::texture& texture, int* u, int* v ) {
+	const __m128 xs = _mm_add_ps( _mm_set1_ps( x ), _mm_setr_ps( 0, 1, 2, 3 ) );
 
-		b.x * m00 + b.y * m01 + b.z * m02,
-		b.x * m10 + b.y * m11 + b.z * m12,
-		b.x * m20 + b.y * m21 + b.z * m22
+	// same operations (and order) as mat3x3f * vec3f( x, y, 1 )
+	const __m128 fu = _mm_add_ps( _mm_add_ps( _mm_mul_ps( xs, _mm_set1_ps( m.m00 ) ), _mm_set1_ps( y * m.m01 ) ), _mm_set1_ps( m.m02 ) );
+	const __m128 fv = _mm_add_ps( _mm_add_ps( _mm_mul_ps( xs, _mm_set1_ps( m.m10 ) ), _mm_set1_ps( y * m.m11 ) ), _mm_set1_ps( m.m12 ) );
 
-	);
+	const __m128i iu = __toygl_floor( fu );
+	const __m128i iv = __toygl_floor( fv );
+	const __m128i xmax = _mm_set1_epi32( texture.xmax );
+	const __m128i ymax = _mm_set1_epi32( texture.ymax );
+
+	if( texture.wrap == tgl::wrap::repeat ) {
+		_mm_storeu_si128( (__m128i*) u, _mm_and_si128( iu, xmax ) );
+		_mm_storeu_si128( (__m128i*) v, _mm_and_si128( iv, ymax ) );
+	}else{
+		_mm_storeu_si128( (__m128i*) u, __toygl_clamp( iu, xmax ) );
+		_mm_storeu_si128( (__m128i*) v, __toygl_clamp( iv, ymax ) );
+	}
 }
+#endif
 
-tgl::mat3x3f tgl::mat3x3f::operator*( const mat3x3f& b ) {
-	return mat3x3f {
+#if defined(TOYGL_ENABLE_3D) && !defined(TOYGL_ENABLE_DOUBLE)
+void tgl::simd::project( float* xs, float* ys, float* zs, const float* p ) {
+	const __m128 s = _mm_set1_ps( p[3] );
 
-		b.m00 * m00 + b.m10 * m01 + b.m20 * m02,
-		b.m01 * m00 + b.m11 * m01 + b.m21 * m02,
-		b.m02 * m00 + b.m12 * m01 + b.m22 * m02,
+	// same operations (and order) as renderer::project_vector
+	const __m128 x = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( xs ), _mm_set1_ps( p[0] ) ), s );
+	const __m128 y = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( ys ), _mm_set1_ps( p[1] ) ), s );
+	const __m128 z = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( zs ), _mm_set1_ps( p[2] ) ), s );
 
-		b.m00 * m10 + b.m10 * m11 + b.m20 * m12,
-		b.m01 * m10 + b.m11 * m11 + b.m21 * m12,
-		b.m02 * m10 + b.m12 * m11 + b.m22 * m12,
+	const __m128 rzc = _mm_set1_ps( p[4] ), rzs = _mm_set1_ps( p[5] );
+	const __m128 ryc = _mm_set1_ps( p[6] ), rys = _mm_set1_ps( p[7] );
+	const __m128 rxc = _mm_set1_ps( p[8] ), rxs = _mm_set1_ps( p[9] );
 
-		b.m00 * m20 + b.m10 * m12 + b.m20 * m22,
-		b.m01 * m20 + b.m11 * m12 + b.m21 * m22,
-		b.m02 * m20 + b.m12 * m12 + b.m22 * m22,
+	const __m128 a = _mm_add_ps( _mm_mul_ps( rzs, y ), _mm_mul_ps( rzc, x ) );
+	const __m128 b = _mm_sub_ps( _mm_mul_ps( rzc, y ), _mm_mul_ps( rzs, x ) );
+	const __m128 c = _mm_add_ps( _mm_mul_ps( ryc, z ), _mm_mul_ps( rys, a ) );
 
-	};
-}
+	const __m128 rx = _mm_sub_ps( _mm_mul_ps( ryc, a ), _mm_mul_ps( rys, z ) );
+	const __m128 ry = _mm_add_ps( _mm_mul_ps( rxs, c ), _mm_mul_ps( rxc, b ) );
+	const __m128 rz = _mm_sub_ps( _mm_mul_ps( rxc, c ), _mm_mul_ps( rxs, b ) );
 
-tgl::trig2f::trig2f( vec2f v1, vec2f v2, vec2f v3 ) {
-	this->v1 = v1;
-	this->v2 = v2;
-	this->v3 = v3;
+	const __m128 d = _mm_add_ps( rz, _mm_set1_ps( p[10] ) );
+	const __m128 m = _mm_div_ps( _mm_set1_ps( p[12] ), _mm_mul_ps( d, _mm_set1_ps( p[11] ) ) );
+
+	_mm_storeu_ps( xs, _mm_add_ps( _mm_mul_ps( rx, m ), _mm_set1_ps( p[14] ) ) );
+	_mm_storeu_ps( ys, _mm_add_ps( _mm_mul_ps( ry, m ), _mm_set1_ps( p[15] ) ) );
+	_mm_storeu_ps( zs, _mm_mul_ps( d, _mm_set1_ps( p[13] ) ) );
 }
+#endif
+
+#endif
 
 bool tgl::math::invert_matrix( const mat3x3f& m, mat3x3f& im ) {
 
@@ -1003,6 +3394,11 @@ inline int tgl::math::max_clamp( int value, int max ) {
 	return v > max ? max : v;
 }
 
+inline int tgl::math::clamp( int value, int min, int max ) {
+	const int v = value < min ? min : value;
+	return v > max ? max : v;
+}
+
 inline float tgl::math::half_cross( float a, float b, vec2i& v2 ) {
 	return (a - v2.x) * (b - v2.y);
 }
@@ -1011,6 +3407,34 @@ inline float tgl::math::cross( float x1, float y1, float x2, float y2, float x3,
 	return (x1 - x3) * (y2 - y3) - (x2 - x3) * (y1 - y3);
 }
 
+inline long long tgl::math::floor_div( long long a, long long b ) {
+	const long long q = a / b;
+	return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+inline long long tgl::math::ceil_div( long long a, long long b ) {
+	return - floor_div( - a, b );
+}
+
+inline int tgl::math::isqrt( int value ) {
+	int root = std::sqrt( (double) value );
+
+	// correct rounding errors of the floating point root
+	while( root * root > value ) root --;
+	while( (root + 1) * (root + 1) <= value ) root ++;
+
+	return root;
+}
+
+inline depth_tgl tgl::math::depth_value( float depth ) {
+#ifdef TOYGL_ENABLE_DEPTH16
+	// 8.8 fixed point, clamped to the 16 bit range
+	return (depth_tgl) std::min( std::max( depth * 256.0f, 0.0f ), 65535.0f );
+#else
+	return depth;
+#endif
+}
+
 inline int tgl::math::max( int a, int b, int c ) {
 	return std::max( std::max( a, b ), c );
 }